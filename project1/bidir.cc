@@ -0,0 +1,193 @@
+// C++ standard I/O and library includes
+#include <vector>
+#include <unordered_map>
+
+using std::vector ;
+
+#include "bidir.h"
+#include "profile.h"
+
+namespace {
+
+const int NCELLS = IDIM*JDIM ;
+const unsigned long long CELL_MASK = (1ULL << NCELLS)-1 ;
+
+inline unsigned long long pegsOf(unsigned long long key) {
+  return key & CELL_MASK ;
+}
+inline unsigned long long holesOf(unsigned long long key) {
+  return (key >> NCELLS) & CELL_MASK ;
+}
+inline unsigned long long makeKey(unsigned long long pegs,
+                                  unsigned long long holes) {
+  return pegs | (holes << NCELLS) ;
+}
+
+} // end namespace
+
+void bidir_search::Init(const game_state &s, size_t max_states) {
+  start = s ;
+  this->max_states = max_states ;
+  peg_count = s.size() ;
+  jumps.clear() ;
+  fseen.clear() ;
+  bseen.clear() ;
+  flevel.clear() ;
+  blevel.clear() ;
+  next.clear() ;
+  fdepth = bdepth = 0 ;
+  meeting = false ;
+  pos = 0 ;
+  done = false ;
+  status = 0 ;
+  expanded = 0 ;
+  if(peg_count <= 1) {
+    status = peg_count ;
+    done = true ;
+    return ;
+  }
+  const unsigned long long key = s.Pack() ;
+  const unsigned long long cells = pegsOf(key) | holesOf(key) ;
+
+  // The jumps that fit on this layout, in the directions of game_state
+  for(int i=0;i<IDIM;++i)
+    for(int j=0;j<JDIM;++j)
+      for(int d=0;d<4;++d) {
+        move m(i,j,d) ;
+        int di = d==0?1:(d==1?-1:0) ;
+        int dj = d==2?1:(d==3?-1:0) ;
+        int i2 = i+2*di, j2 = j+2*dj ;
+        if(i2 < 0 || i2 >= IDIM || j2 < 0 || j2 >= JDIM)
+          continue ;
+        jump J ;
+        J.a = 1ULL << (j+i*JDIM) ;
+        J.b = 1ULL << ((j+dj)+(i+di)*JDIM) ;
+        J.c = 1ULL << (j2+i2*JDIM) ;
+        J.m = m.Pack() ;
+        if((cells & (J.a|J.b|J.c)) == (J.a|J.b|J.c))
+          jumps.push_back(J) ;
+      }
+
+  // Forward frontier starts at s, backward frontier at every single peg
+  // state on the layout
+  link root = {0,0} ;
+  fseen[key] = root ;
+  flevel.push_back(key) ;
+  for(int c=0;c<NCELLS;++c)
+    if(cells & (1ULL << c)) {
+      unsigned long long goal = makeKey(1ULL << c,cells & ~(1ULL << c)) ;
+      bseen[goal] = root ;
+      blevel.push_back(goal) ;
+    }
+  nextLevel() ;
+}
+
+void bidir_search::nextLevel() {
+  pos = 0 ;
+  // Once the peg counts of the two frontiers meet, look for a state on
+  // both of them
+  if(fdepth+bdepth == peg_count-1) {
+    meeting = true ;
+    return ;
+  }
+  if(flevel.empty() || blevel.empty()) {
+    done = true ;
+    return ;
+  }
+  // Grow the smaller frontier
+  forward = flevel.size() <= blevel.size() ;
+  next.clear() ;
+}
+
+bool bidir_search::expandState() {
+  const unsigned long long key = forward ? flevel[pos] : blevel[pos] ;
+  ++pos ;
+  const unsigned long long pegs = pegsOf(key) ;
+  const unsigned long long holes = holesOf(key) ;
+  link_map &seen = forward ? fseen : bseen ;
+  for(size_t j=0;j<jumps.size();++j) {
+    const jump &J = jumps[j] ;
+    // A jump forward, or a jump undone on the backward side
+    bool fits = forward ? (holes & J.a) && (pegs & J.b) && (pegs & J.c) :
+                          (pegs & J.a) && (holes & J.b) && (holes & J.c) ;
+    if(!fits)
+      continue ;
+    const unsigned long long flip = J.a|J.b|J.c ;
+    const unsigned long long neighbour = makeKey(pegs^flip,holes^flip) ;
+    ++expanded ;
+    link l = {key,J.m} ;
+    if(!seen.insert(link_map::value_type(neighbour,l)).second)
+      continue ;
+    if(fseen.size()+bseen.size() > max_states)
+      return false ;
+    next.push_back(neighbour) ;
+  }
+  return true ;
+}
+
+bool bidir_search::step(long node_budget) {
+  PROFILE_SCOPE("bidir_search::step") ;
+  long n = 0 ;
+  while(!done && n < node_budget) {
+    if(meeting) {
+      if(pos == flevel.size()) {
+        done = true ;
+        break ;
+      }
+      if(bseen.find(flevel[pos]) != bseen.end()) {
+        meet = flevel[pos] ;
+        status = 1 ;
+        done = true ;
+        break ;
+      }
+      ++pos ;
+      ++n ;
+      continue ;
+    }
+    vector<unsigned long long> &level = forward ? flevel : blevel ;
+    if(pos == level.size()) {
+      // The level is finished, the states found make the next one
+      level.swap(next) ;
+      ++(forward ? fdepth : bdepth) ;
+      nextLevel() ;
+      continue ;
+    }
+    long before = expanded ;
+    if(!expandState()) {
+      status = -1 ;
+      done = true ;
+      break ;
+    }
+    n += 1+expanded-before ;
+  }
+  return done ;
+}
+
+int bidir_search::solution(move solution[]) const {
+  if(status != 1 || peg_count <= 1)
+    return 0 ;
+  // Moves from the start to the meeting state, recovered in reverse
+  unsigned long long key = meet ;
+  for(int d=fdepth-1;d>=0;--d) {
+    const link &l = fseen.find(key)->second ;
+    solution[d].Unpack(l.m) ;
+    key = l.next ;
+  }
+  // then the moves from the meeting state down to a single peg
+  int size = fdepth ;
+  key = meet ;
+  for(int d=0;d<bdepth;++d) {
+    const link &l = bseen.find(key)->second ;
+    solution[size++].Unpack(l.m) ;
+    key = l.next ;
+  }
+  return size ;
+}
+
+void bidir_search::Free() {
+  link_map().swap(fseen) ;
+  link_map().swap(bseen) ;
+  vector<unsigned long long>().swap(flevel) ;
+  vector<unsigned long long>().swap(blevel) ;
+  vector<unsigned long long>().swap(next) ;
+}
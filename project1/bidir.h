@@ -0,0 +1,87 @@
+#ifndef BIDIR_H
+#define BIDIR_H
+
+// C++ standard I/O and library includes
+#include <vector>
+#include <unordered_map>
+
+#include "game.h"
+#include "search.h"
+
+// Bidirectional (meet in the middle) search.  The search grows a set of
+// states forward from s and a set of states backward, by undoing jumps,
+// from every single peg state on the same layout.  Each level expands the
+// side with the smaller frontier, one peg count at a time.  A solution
+// is found when the two frontiers share a state.  Because every move
+// removes one peg, the frontiers can only meet when their peg counts
+// match, so only that pair of levels is compared.
+//
+// Like dfs_search, the search is advanced a bounded number of nodes at a
+// time, so the caller can service messages or enforce a time limit in
+// between steps.  It gives up as soon as it stores more than max_states
+// states, which bounds its memory.
+class bidir_search {
+public:
+  bidir_search() : done(true), status(0), expanded(0) {}
+  // Start a new search rooted at game state s
+  void Init(const game_state &s, size_t max_states) ;
+  // Generate at most node_budget states.  Returns true when the search
+  // is done.
+  bool step(long node_budget) ;
+  // The search is done when it has settled s or given up
+  bool is_done() const { return done ; }
+  // 1 if s is solved, 0 if s has no solution, -1 if the search gave up
+  int result() const { return status ; }
+  // Copy the moves of the solution into solution and return how many
+  int solution(move solution[]) const ;
+  // The number of states generated so far
+  long nodes() const { return expanded ; }
+  // The game state the search started from
+  const game_state &root() const { return start ; }
+  // Release the memory of the stored states
+  void Free() ;
+private:
+  // A jump on packed states: the landing, jumped and origin cells as peg
+  // bits, and the move that makes it
+  struct jump {
+    unsigned long long a, b, c ;
+    unsigned char m ;
+  } ;
+  // How a state was reached: the neighbouring state towards the start
+  // (forward side) or towards a single peg (backward side) and the move
+  // between them, in the forward direction
+  struct link {
+    unsigned long long next ;
+    unsigned char m ;
+  } ;
+  typedef std::unordered_map<unsigned long long,link> link_map ;
+
+  // Add the states one jump from level[pos] on the side being expanded,
+  // returns false once more than max_states states are stored
+  bool expandState() ;
+  // Choose the side of the next level, or settle the search
+  void nextLevel() ;
+
+  game_state start ;
+  size_t max_states ;
+  int peg_count ;                 // Pegs on the start
+  std::vector<jump> jumps ;
+  link_map fseen, bseen ;
+  std::vector<unsigned long long> flevel, blevel, next ;
+  int fdepth, bdepth ;
+  bool forward ;                  // The side of the level being expanded
+  bool meeting ;                  // The levels are being compared
+  size_t pos ;                    // Next state of the level to look at
+  unsigned long long meet ;       // State on both frontiers
+  bool done ;
+  int status ;
+  long expanded ;
+} ;
+
+// Heuristic used to choose the bidirectional search for a puzzle: it
+// pays off for boards with many pegs, where the forward tree is deep.
+inline bool preferBidirectional(const game_state &s, int min_pegs) {
+  return min_pegs > 0 && s.size() >= min_pegs ;
+}
+
+#endif
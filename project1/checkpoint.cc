@@ -0,0 +1,99 @@
+// C++ standard I/O and library includes
+#include <fstream>
+#include <vector>
+
+using std::vector ;
+using std::ifstream ;
+using std::ios ;
+
+// Standard Includes for MPI, C and OS calls
+#include <mpi.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "checkpoint.h"
+
+static const char CHECKPOINT_MAGIC[8] = {'P','E','G','C','K','P','T','1'} ;
+
+bool checkpoint_log::Create(const char *filename, unsigned int games,
+                            double seconds) {
+  file.open(filename,ios::out|ios::binary|ios::trunc) ;
+  file.write(CHECKPOINT_MAGIC,sizeof(CHECKPOINT_MAGIC)) ;
+  file.write((const char *)&games,sizeof(games)) ;
+  file.flush() ;
+  interval = seconds ;
+  last_flush = MPI_Wtime() ;
+  return bool(file) ;
+}
+
+bool checkpoint_log::Resume(const char *filename, unsigned int games,
+                            double seconds, vector<long> &saved) {
+  saved.assign(games,-1) ;
+  ifstream in(filename,ios::in|ios::binary) ;
+  if(!in)
+    return Create(filename,games,seconds) ;
+  char magic[sizeof(CHECKPOINT_MAGIC)] ;
+  unsigned int saved_games ;
+  in.read(magic,sizeof(magic)) ;
+  in.read((char *)&saved_games,sizeof(saved_games)) ;
+  if(!in || memcmp(magic,CHECKPOINT_MAGIC,sizeof(magic)) != 0 ||
+     saved_games != games)
+    return false ;
+
+  // Read whole records, remembering where the last one ends
+  long good = sizeof(CHECKPOINT_MAGIC)+sizeof(saved_games) ;
+  unsigned char buf[RESULT_MAX_SIZE] ;
+  while(true) {
+    int len = in.get() ;
+    if(len == EOF || len > RESULT_MAX_SIZE)
+      break ;
+    in.read((char *)buf,len) ;
+    solve_result result ;
+    if(!in || !result.Unpack(buf,len) || result.task < 0 ||
+       result.task >= int(games))
+      break ;
+    if(saved[result.task] < 0 && result.status != solve_result::TIMED_OUT)
+      saved[result.task] = good ;
+    good += 1+len ;
+  }
+  in.close() ;
+
+  // Drop anything after the last whole record and add to the end
+  if(truncate(filename,good) != 0)
+    return false ;
+  file.open(filename,ios::out|ios::binary|ios::app) ;
+  saved_file.open(filename,ios::in|ios::binary) ;
+  interval = seconds ;
+  last_flush = MPI_Wtime() ;
+  return file && saved_file ;
+}
+
+bool checkpoint_log::Load(long offset, solve_result &result) {
+  unsigned char buf[RESULT_MAX_SIZE] ;
+  saved_file.clear() ;
+  saved_file.seekg(offset) ;
+  int len = saved_file.get() ;
+  if(len == EOF || len > RESULT_MAX_SIZE)
+    return false ;
+  saved_file.read((char *)buf,len) ;
+  return saved_file && result.Unpack(buf,len) ;
+}
+
+void checkpoint_log::Add(const solve_result &result) {
+  if(!enabled() || result.status == solve_result::TIMED_OUT)
+    return ;
+  unsigned char buf[RESULT_MAX_SIZE] ;
+  unsigned char len = result.Pack(buf) ;
+  file.put(len) ;
+  file.write((const char *)buf,len) ;
+}
+
+void checkpoint_log::Flush(bool force) {
+  if(!enabled())
+    return ;
+  double now = MPI_Wtime() ;
+  if(!force && now-last_flush < interval)
+    return ;
+  file.flush() ;
+  last_flush = now ;
+}
@@ -0,0 +1,51 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+// C++ standard I/O and library includes
+#include <fstream>
+#include <vector>
+
+#include "result.h"
+
+// A record of the puzzles a run has finished, so that a run stopped by
+// the queue's time limit can be resumed without solving them again.
+// Results are added as puzzles finish and the file is flushed every
+// interval seconds, so a killed run loses at most that much work.
+//
+// File format (native byte order):
+//   char     magic[8]            "PEGCKPT1"
+//   unsigned games               number of puzzles in the input file
+//   { unsigned char len ; unsigned char result[len] } ...
+//                                results packed by solve_result::Pack
+class checkpoint_log {
+public:
+  checkpoint_log() : interval(0), last_flush(0) {}
+  // Start a new checkpoint file for a run of games puzzles
+  bool Create(const char *filename, unsigned int games, double interval) ;
+  // Find the results saved in a checkpoint file and reopen it to add
+  // more.  saved[t] is where the result of puzzle t is kept, -1 if it
+  // has none, and Load reads it back, so resumed results are read as
+  // they are written out rather than held in memory.  Timed out
+  // results in the file are left to be tried again.  A record cut
+  // short by a killed run is dropped.  A missing file starts a new
+  // checkpoint.  Returns false if the file can't be used or was
+  // written for a different number of puzzles.
+  bool Resume(const char *filename, unsigned int games, double interval,
+              std::vector<long> &saved) ;
+  // Read the result saved at offset, as found by Resume
+  bool Load(long offset, solve_result &result) ;
+  bool enabled() const { return file.is_open() ; }
+  // Save the result of a finished puzzle.  Puzzles that ran past the
+  // time limit are not saved, so a resumed run tries them again.
+  void Add(const solve_result &result) ;
+  // Write the saved results to disk if interval seconds have passed
+  // since the last time, or always when force is set
+  void Flush(bool force) ;
+private:
+  std::ofstream file ;
+  std::ifstream saved_file ;              // The same file, to Load from
+  double interval ;
+  double last_flush ;
+} ;
+
+#endif
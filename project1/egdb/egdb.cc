@@ -0,0 +1,64 @@
+#include "game.h"
+#include "endgame.h"
+#include "puzzles.h"
+#include <stdlib.h>
+
+// C++ standard I/O and library includes
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+
+// C++ stadard library using statements
+using std::cout ;
+using std::cerr ;
+using std::endl ;
+
+using std::vector ;
+using std::string ;
+
+using std::ifstream ;
+using std::ios ;
+
+// Build the endgame database used by project1 --endgame.  The database
+// covers every board layout that occurs in the given puzzle files, for
+// all states with at most k pegs.
+int main(int argc, char *argv[]) {
+    if (argc < 4) {
+        cerr << "usage: " << argv[0] << " k database puzzles.dat [puzzles.dat ...]" << endl ;
+        return -1 ;
+    }
+    int k = atoi(argv[1]) ;
+    if (k < 1 || k > IDIM*JDIM) {
+        cerr << "k must be between 1 and " << IDIM*JDIM << endl ;
+        return -1 ;
+    }
+
+    // Collect the layout (the cells that are not NA) of every puzzle
+    vector<unsigned int> layouts ;
+    for (int f=3; f<argc; ++f) {
+        puzzle_reader input ;
+        if (!input.Open(argv[f])) {
+            cerr << "can't open " << argv[f] << endl ;
+            return -1 ;
+        }
+        unsigned char board[IDIM*JDIM] ;
+        for (unsigned int g=0; g<input.size(); ++g) {
+            if (!input.Next(board)) {
+                cerr << "malformed puzzle file " << argv[f] << endl ;
+                return -1 ;
+            }
+            game_state s ;
+            s.Init(board) ;
+            unsigned long long key = s.Pack() ;
+            layouts.push_back((key | (key >> (IDIM*JDIM))) & ((1u << (IDIM*JDIM))-1)) ;
+        }
+    }
+
+    if (!endgame_db::Build(layouts, k, argv[2])) {
+        cerr << "failed to write " << argv[2] << endl ;
+        return -1 ;
+    }
+    cout << "wrote " << argv[2] << " for " << layouts.size() << " puzzles with k = " << k << endl ;
+    return 0 ;
+}
@@ -0,0 +1,260 @@
+// C++ standard I/O and library includes
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+
+using std::vector ;
+using std::ofstream ;
+using std::ios ;
+
+// Standard Includes for C and OS calls
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "endgame.h"
+
+static const char DB_MAGIC[8] = {'P','E','G','E','G','D','B','1'} ;
+static const unsigned int CELL_MASK = (1u << (IDIM*JDIM))-1 ;
+
+// Binomial coefficients C(n,r) for n,r <= IDIM*JDIM
+static unsigned long long binomial(int n, int r) {
+  static unsigned long long table[IDIM*JDIM+1][IDIM*JDIM+1] ;
+  static bool initialized = false ;
+  if(!initialized) {
+    for(int i=0;i<=IDIM*JDIM;++i) {
+      table[i][0] = 1 ;
+      for(int j=1;j<=i;++j)
+        table[i][j] = table[i-1][j-1] + (j<i?table[i-1][j]:0) ;
+    }
+    initialized = true ;
+  }
+  if(r < 0 || r > n)
+    return 0 ;
+  return table[n][r] ;
+}
+
+static int countBits(unsigned int x) {
+  return __builtin_popcount(x) ;
+}
+
+// Number of bits the database keeps for a layout of n cells: one per
+// placement of 1 to k pegs
+static unsigned long long layoutBits(int n, int k) {
+  unsigned long long total = 0 ;
+  for(int p=1;p<=k;++p)
+    total += binomial(n,p) ;
+  return total ;
+}
+
+// Index of a peg placement among all placements of the same number of
+// pegs on the layout cells (combinatorial number system)
+static unsigned long long rankPegs(unsigned int cells, unsigned int pegs) {
+  unsigned long long rank = 0 ;
+  int t = 0, p = 0 ;
+  for(int c=0;c<IDIM*JDIM;++c)
+    if(cells & (1u << c)) {
+      if(pegs & (1u << c))
+        rank += binomial(t,++p) ;
+      ++t ;
+    }
+  return rank ;
+}
+
+unsigned long long endgame_db::bitIndex(const layout_entry &l,
+                                        unsigned int pegs) const {
+  const int n = countBits(l.cells) ;
+  const int p = countBits(pegs) ;
+  return l.bit_offset + layoutBits(n,p-1) + rankPegs(l.cells,pegs) ;
+}
+
+bool endgame_db::Open(const char *filename) {
+  Close() ;
+  int fd = open(filename,O_RDONLY) ;
+  if(fd < 0)
+    return false ;
+  struct stat st ;
+  if(fstat(fd,&st) != 0 || size_t(st.st_size) < sizeof(DB_MAGIC)+8) {
+    close(fd) ;
+    return false ;
+  }
+  void *p = mmap(0,st.st_size,PROT_READ,MAP_SHARED,fd,0) ;
+  close(fd) ;
+  if(p == MAP_FAILED)
+    return false ;
+  base = p ;
+  length = st.st_size ;
+
+  const unsigned char *buf = (const unsigned char *)base ;
+  unsigned int header[2] ;
+  memcpy(header,buf+sizeof(DB_MAGIC),sizeof(header)) ;
+  k = header[0] ;
+  nlayouts = header[1] ;
+  size_t table_end = sizeof(DB_MAGIC)+sizeof(header)+
+    size_t(nlayouts)*sizeof(layout_entry) ;
+  if(memcmp(buf,DB_MAGIC,sizeof(DB_MAGIC)) != 0 || k < 1 ||
+     k > IDIM*JDIM || table_end > length) {
+    Close() ;
+    return false ;
+  }
+  layouts = (const layout_entry *)(buf+sizeof(DB_MAGIC)+sizeof(header)) ;
+  bits = buf+table_end ;
+  // Make sure the last layout's bits are inside the file
+  if(nlayouts > 0) {
+    const layout_entry &l = layouts[nlayouts-1] ;
+    unsigned long long end = l.bit_offset+layoutBits(countBits(l.cells),k) ;
+    if(table_end+(end+7)/8 > length) {
+      Close() ;
+      return false ;
+    }
+  }
+  return true ;
+}
+
+void endgame_db::Close() {
+  if(base != 0)
+    munmap(base,length) ;
+  base = 0 ;
+  length = 0 ;
+  k = 0 ;
+  nlayouts = 0 ;
+  layouts = 0 ;
+  bits = 0 ;
+}
+
+int endgame_db::findLayout(const game_state &s) const {
+  if(base == 0)
+    return -1 ;
+  const unsigned long long key = s.Pack() ;
+  const unsigned int cells = (key | (key >> (IDIM*JDIM))) & CELL_MASK ;
+  int lo = 0, hi = nlayouts ;
+  while(lo < hi) {
+    int mid = (lo+hi)/2 ;
+    if(layouts[mid].cells < cells)
+      lo = mid+1 ;
+    else
+      hi = mid ;
+  }
+  if(lo < nlayouts && layouts[lo].cells == cells)
+    return lo ;
+  return -1 ;
+}
+
+int endgame_db::Lookup(int layout, const game_state &s) const {
+  if(layout < 0)
+    return -1 ;
+  const unsigned int pegs = s.Pack() & CELL_MASK ;
+  const int p = countBits(pegs) ;
+  if(p > k)
+    return -1 ;
+  if(p == 0)
+    return 0 ;
+  unsigned long long b = bitIndex(layouts[layout],pegs) ;
+  return (bits[b/8] >> (b%8)) & 1 ;
+}
+
+int endgame_db::Solve(int layout, const game_state &s, move solution[]) const {
+  // Every solvable state has a move to a solvable state with one less
+  // peg, so follow those moves down to a single peg
+  game_state g = s ;
+  int size = 0 ;
+  while(!g.Winner()) {
+    move moves[MAX_MOVES] ;
+    const int nmoves = g.validMoveList(moves) ;
+    int m = 0 ;
+    for(;m<nmoves;++m) {
+      game_state child = g ;
+      child.makeMove(moves[m]) ;
+      if(Lookup(layout,child) == 1)
+        break ;
+    }
+    if(m == nmoves)
+      break ;
+    solution[size++] = moves[m] ;
+    g.makeMove(moves[m]) ;
+  }
+  return size ;
+}
+
+bool endgame_db::Build(const vector<unsigned int> &cell_list, int k,
+                       const char *filename) {
+  if(k < 1 || k > IDIM*JDIM)
+    return false ;
+  vector<unsigned int> cells(cell_list) ;
+  std::sort(cells.begin(),cells.end()) ;
+  cells.erase(std::unique(cells.begin(),cells.end()),cells.end()) ;
+
+  vector<layout_entry> table(cells.size()) ;
+  unsigned long long total = 0 ;
+  for(size_t l=0;l<cells.size();++l) {
+    table[l].cells = cells[l] ;
+    table[l].pad = 0 ;
+    table[l].bit_offset = total ;
+    total += layoutBits(countBits(cells[l]),k) ;
+  }
+  vector<unsigned char> bitset((total+7)/8,0) ;
+
+  // The database object is used for its index computation only
+  endgame_db db ;
+  for(size_t l=0;l<cells.size();++l) {
+    const layout_entry &layout = table[l] ;
+
+    // Collect the jumps that fit on this layout as (landing, jumped,
+    // origin) cell masks, using the same directions as game_state
+    vector<unsigned int> jumps ;
+    for(int i=0;i<IDIM;++i)
+      for(int j=0;j<JDIM;++j)
+        for(int d=0;d<4;++d) {
+          int di = d==0?1:(d==1?-1:0) ;
+          int dj = d==2?1:(d==3?-1:0) ;
+          int i2 = i+2*di, j2 = j+2*dj ;
+          if(i2 < 0 || i2 >= IDIM || j2 < 0 || j2 >= JDIM)
+            continue ;
+          unsigned int a = 1u << (j+i*JDIM) ;
+          unsigned int b = 1u << ((j+dj)+(i+di)*JDIM) ;
+          unsigned int c = 1u << (j2+i2*JDIM) ;
+          if((layout.cells & (a|b|c)) == (a|b|c)) {
+            jumps.push_back(a) ;
+            jumps.push_back(b) ;
+            jumps.push_back(c) ;
+          }
+        }
+
+    // Retrograde analysis: every single peg state is solved, and undoing
+    // a jump from a solvable state gives a solvable state with one more
+    // peg.  Every solvable state is reached this way.
+    vector<unsigned int> level, next ;
+    for(int c=0;c<IDIM*JDIM;++c)
+      if(layout.cells & (1u << c))
+        level.push_back(1u << c) ;
+    for(int p=1;p<=k;++p) {
+      next.clear() ;
+      for(size_t s=0;s<level.size();++s) {
+        const unsigned int pegs = level[s] ;
+        unsigned long long b = db.bitIndex(layout,pegs) ;
+        if(bitset[b/8] & (1 << (b%8)))
+          continue ;
+        bitset[b/8] |= 1 << (b%8) ;
+        if(p == k)
+          continue ;
+        for(size_t m=0;m<jumps.size();m+=3)
+          if((pegs & jumps[m]) && !(pegs & (jumps[m+1]|jumps[m+2])))
+            next.push_back(pegs ^ jumps[m] ^ jumps[m+1] ^ jumps[m+2]) ;
+      }
+      level.swap(next) ;
+    }
+  }
+
+  ofstream out(filename,ios::out|ios::binary) ;
+  unsigned int header[2] = {(unsigned int)k,(unsigned int)cells.size()} ;
+  out.write(DB_MAGIC,sizeof(DB_MAGIC)) ;
+  out.write((const char *)header,sizeof(header)) ;
+  if(!table.empty())
+    out.write((const char *)&table[0],table.size()*sizeof(layout_entry)) ;
+  if(!bitset.empty())
+    out.write((const char *)&bitset[0],bitset.size()) ;
+  return bool(out) ;
+}
@@ -0,0 +1,63 @@
+#ifndef ENDGAME_H
+#define ENDGAME_H
+
+// C++ standard I/O and library includes
+#include <vector>
+
+#include "game.h"
+
+// A database of which game states with at most k pegs can be solved.
+// The database covers a set of board layouts (the cells that are not
+// NA).  For each layout, and each peg count from 1 to k, one bit is kept
+// per placement of the pegs on the layout's cells.  The database is built
+// once by retrograde analysis (see the egdb tool) and memory mapped by
+// the solver, which then stops searching once a state has k pegs.
+//
+// File format (native byte order):
+//   char     magic[8]            "PEGEGDB1"
+//   unsigned k                   largest peg count in the database
+//   unsigned nlayouts
+//   { unsigned cells ; unsigned pad ; unsigned long long bit_offset } [nlayouts]
+//                                sorted by cells (bit j+i*JDIM per cell)
+//   bitsets                      one per layout, starting at bit_offset
+class endgame_db {
+public:
+  endgame_db() : base(0), length(0), k(0), nlayouts(0), layouts(0), bits(0) {}
+  ~endgame_db() { Close() ; }
+  // Memory map a database file, returns false if it can't be used
+  bool Open(const char *filename) ;
+  void Close() ;
+  bool enabled() const { return base != 0 ; }
+  // Largest peg count covered by the database
+  int pegLimit() const { return k ; }
+  // Index of the layout of s in the database, -1 if it is not covered
+  int findLayout(const game_state &s) const ;
+  // Returns 1 if s can be solved, 0 if it can't, and -1 if the database
+  // doesn't know (s has more than pegLimit() pegs).  layout must be the
+  // result of findLayout(s).
+  int Lookup(int layout, const game_state &s) const ;
+  // Fill solution with the moves that solve s using the database, s
+  // must be solvable according to Lookup.  Returns the number of moves.
+  int Solve(int layout, const game_state &s, move solution[]) const ;
+  // Build the database for the given layouts with retrograde analysis
+  // from every single peg state and write it to filename
+  static bool Build(const std::vector<unsigned int> &cells, int k,
+                    const char *filename) ;
+private:
+  struct layout_entry {
+    unsigned int cells ;
+    unsigned int pad ;
+    unsigned long long bit_offset ;
+  } ;
+  // Position of the bit for state s of layout
+  unsigned long long bitIndex(const layout_entry &l, unsigned int pegs) const ;
+
+  void *base ;
+  size_t length ;
+  int k ;
+  int nlayouts ;
+  const layout_entry *layouts ;
+  const unsigned char *bits ;
+} ;
+
+#endif
@@ -38,7 +38,7 @@ void game_state::Init(unsigned char buf[IDIM*JDIM]) {
     }
 }
 
-void game_state::SaveBoard(unsigned char buf[IDIM*JDIM]) {
+void game_state::SaveBoard(unsigned char buf[IDIM*JDIM]) const {
   for(int i=0;i<IDIM*JDIM;++i)
     switch(board[i]) {
     case HOLE:
@@ -52,6 +52,16 @@ void game_state::SaveBoard(unsigned char buf[IDIM*JDIM]) {
       break ;
     }
 }
+unsigned long long game_state::Pack() const {
+  unsigned long long key = 0 ;
+  for(int i=0;i<IDIM*JDIM;++i)
+    if(board[i]==PEG)
+      key |= 1ULL << i ;
+    else if(board[i]==HOLE)
+      key |= 1ULL << (i+IDIM*JDIM) ;
+  return key ;
+}
+
   void game_state::makeMove(const move &m) {
     const int i = m.i ;
     const int j = m.j ;
@@ -102,6 +112,17 @@ void game_state::SaveBoard(unsigned char buf[IDIM*JDIM]) {
             move_list.push_back(move(i,j,m)) ;
         }
   }
+
+  int game_state::validMoveList(move move_list[]) const {
+    int count = 0 ;
+    for(int i=0;i<IDIM;++i)
+      for(int j=0;j<JDIM;++j)
+        for(int m=0;m<4;++m){
+          if(validMove(move(i,j,m)))
+            move_list[count++] = move(i,j,m) ;
+        }
+    return count ;
+  }
   std::ostream &game_state::Print(std::ostream &s) const {
     for(int j=0;j<JDIM;++j){
       for(int i=0;i<IDIM;++i) 
@@ -113,24 +134,5 @@ void game_state::SaveBoard(unsigned char buf[IDIM*JDIM]) {
           s << ' ' ;
       s << std::endl ;
     }
+    return s ;
   }
-
-bool depthFirstSearch(const game_state &s, int &size, move solution[]) {
-  vector<move> search_tree ;
-  s.validMoveList(search_tree) ;
-  if(search_tree.size() == 0)
-    return s.Winner() ;
-  int loc = size ;
-  solution[size] = move() ;
-  size++ ;
-  for(int i=0;i<search_tree.size();++i) {
-    solution[loc] = search_tree[i] ;
-    game_state new_s = s ;
-    new_s.makeMove(solution[loc]) ;
-    if(depthFirstSearch(new_s, size, solution))
-      return true ;
-  }
-  size = loc ;
-  return false ;
-}
-  
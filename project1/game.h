@@ -17,8 +17,14 @@ struct move {
   int i, j, dir ;
   move() {i=-1;j=-1;dir=-1;}
   move(int in,int jn,int d):i(in),j(jn),dir(d) {}
+  // one byte encoding of a move used when sending moves between processors
+  unsigned char Pack() const { return (i*JDIM+j)*4+dir ; }
+  void Unpack(unsigned char c) { dir = c%4 ; j = (c/4)%JDIM ; i = c/(4*JDIM) ; }
 } ;
 
+// Upper bound on the number of valid moves from any game state
+#define MAX_MOVES (4*IDIM*JDIM)
+
 struct game_state {
   // This structure saves the state of the board (holes, pegs, noholes)
   enum board_slots {HOLE,PEG,NA} ;
@@ -34,20 +40,20 @@ struct game_state {
   // Inititialize the game state from a char string initStringSize length
   void Init(unsigned char buf[IDIM*JDIM]) ;
   // write the state into a character array
-  void SaveBoard(unsigned char buf[IDIM*JDIM]) ;
+  void SaveBoard(unsigned char buf[IDIM*JDIM]) const ;
+  // pack the state into 64 bits, pegs in the low IDIM*JDIM bits and
+  // holes in the next IDIM*JDIM bits.  Used as a key for memo tables.
+  unsigned long long Pack() const ;
   // update the board state based on a move
   void makeMove(const move &m) ;
   // check to see if a move is valid according to the game rules
   bool validMove(const move &m) const ;
   // make a list of all valid moves given the current game state
   void validMoveList(std::vector<move> & move_list) const ;
+  // same as above, but fill a MAX_MOVES array and return the move count
+  int validMoveList(move move_list[]) const ;
   // print out the board to stream s
   std::ostream &Print(std::ostream &s) const ;
 } ;
 
-// Search for a solution to the game, if a solution is found, the
-// vector of moves that obtains this is stored in solution
-extern bool depthFirstSearch(const game_state &s, int &size, move solution[]) ;
-
-
 #endif
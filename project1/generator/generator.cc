@@ -0,0 +1,234 @@
+#include "game.h"
+#include "puzzles.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+// C++ standard I/O and library includes
+#include <iostream>
+#include <vector>
+#include <random>
+
+// C++ stadard library using statements
+using std::cerr ;
+using std::endl ;
+
+using std::vector ;
+
+const int BOARD_SIZE = IDIM*JDIM ;
+const int TRIES = 16 ;                  // Starting pegs tried for each solvable board
+
+// Peg density ranges of the difficulty classes: more pegs means a
+// deeper search
+const double CLASS_PEGS[3][2] = {{0.3,0.5},{0.5,0.7},{0.7,0.95}} ;
+
+struct generator_options {
+    unsigned long count ;
+    const char *output ;
+    unsigned long long seed ;
+    double cells ;                      // Fraction of cells that are part of the board
+    double pegs ;                       // Fraction of board cells holding a peg
+    double mix[3] ;                     // Weights of easy, medium and hard boards
+    bool use_mix ;
+    bool solvable ;                     // Only make boards that have a solution
+    bool binary ;                       // Write the PEGB binary format
+    generator_options() : count(0), output(0), seed(1), cells(0.85), pegs(0.75), use_mix(false),
+                          solvable(false), binary(false) {
+        mix[0] = mix[1] = mix[2] = 1 ;
+    }
+} ;
+
+bool parseOptions(int argc, char *argv[], generator_options &opt) {
+    int files = 0 ;
+    for (int i=1; i<argc; ++i) {
+        if (strcmp(argv[i], "--seed") == 0 && i+1 < argc)
+            opt.seed = strtoull(argv[++i], 0, 10) ;
+        else if (strcmp(argv[i], "--cells") == 0 && i+1 < argc)
+            opt.cells = atof(argv[++i]) ;
+        else if (strcmp(argv[i], "--pegs") == 0 && i+1 < argc)
+            opt.pegs = atof(argv[++i]) ;
+        else if (strcmp(argv[i], "--mix") == 0 && i+1 < argc) {
+            if (sscanf(argv[++i], "%lf:%lf:%lf", &opt.mix[0], &opt.mix[1], &opt.mix[2]) != 3 ||
+                opt.mix[0] < 0 || opt.mix[1] < 0 || opt.mix[2] < 0 ||
+                opt.mix[0]+opt.mix[1]+opt.mix[2] <= 0)
+                return false ;
+            opt.use_mix = true ;
+        }
+        else if (strcmp(argv[i], "--solvable") == 0)
+            opt.solvable = true ;
+        else if (strcmp(argv[i], "--binary") == 0)
+            opt.binary = true ;
+        else if (argv[i][0] == '-' && argv[i][1] == '-')
+            return false ;
+        else if (files == 0) {
+            opt.count = strtoul(argv[i], 0, 10) ; ++files ;
+        }
+        else if (files == 1) {
+            opt.output = argv[i] ; ++files ;
+        }
+        else
+            return false ;
+    }
+    return files == 2 && opt.cells > 0 && opt.cells <= 1 && opt.pegs >= 0 && opt.pegs <= 1 ;
+}
+
+// Generates boards one at a time from a seeded random number generator,
+// so the same options always give the same boards
+struct board_generator {
+    const generator_options &opt ;
+    std::mt19937_64 rng ;
+    // The jumps on a full board as (landing, jumped, origin) cells, in
+    // the directions of game_state
+    vector<int> jumps ;
+
+    board_generator(const generator_options &o) : opt(o), rng(o.seed) {
+        for (int i=0; i<IDIM; ++i)
+            for (int j=0; j<JDIM; ++j)
+                for (int d=0; d<4; ++d) {
+                    int di = d==0?1:(d==1?-1:0) ;
+                    int dj = d==2?1:(d==3?-1:0) ;
+                    int i2 = i+2*di, j2 = j+2*dj ;
+                    if (i2 < 0 || i2 >= IDIM || j2 < 0 || j2 >= JDIM)
+                        continue ;
+                    jumps.push_back(j+i*JDIM) ;
+                    jumps.push_back((j+dj)+(i+di)*JDIM) ;
+                    jumps.push_back(j2+i2*JDIM) ;
+                }
+    }
+
+    double uniform() {
+        return std::uniform_real_distribution<double>(0,1)(rng) ;
+    }
+    int below(int n) {
+        return std::uniform_int_distribution<int>(0,n-1)(rng) ;
+    }
+
+    // Peg density for the next board, drawn from a difficulty class
+    // when a mix is given
+    double pegDensity() {
+        if (!opt.use_mix)
+            return opt.pegs ;
+        double r = uniform()*(opt.mix[0]+opt.mix[1]+opt.mix[2]) ;
+        int c = r < opt.mix[0] ? 0 : (r < opt.mix[0]+opt.mix[1] ? 1 : 2) ;
+        return CLASS_PEGS[c][0] + uniform()*(CLASS_PEGS[c][1]-CLASS_PEGS[c][0]) ;
+    }
+
+    // Choose the cells that are part of the board, at least three
+    void layout(unsigned char board[]) {
+        int n = 0 ;
+        for (int c=0; c<BOARD_SIZE; ++c) {
+            board[c] = uniform() < opt.cells ? '0' : '2' ;
+            n += board[c] == '0' ;
+        }
+        while (n < 3) {
+            int c = below(BOARD_SIZE) ;
+            if (board[c] == '2') {
+                board[c] = '0' ;
+                ++n ;
+            }
+        }
+    }
+
+    int cellCount(const unsigned char board[]) const {
+        int n = 0 ;
+        for (int c=0; c<BOARD_SIZE; ++c)
+            n += board[c] != '2' ;
+        return n ;
+    }
+
+    // A board with pegs placed at random, which may have no solution
+    void randomBoard(unsigned char board[]) {
+        layout(board) ;
+        double density = pegDensity() ;
+        for (int c=0; c<BOARD_SIZE; ++c)
+            if (board[c] == '0' && uniform() < density)
+                board[c] = '1' ;
+    }
+
+    // Undo random jumps from a single peg until the board has pegs
+    // pegs (or no jump can be undone), returns the number of pegs
+    int reverseGame(unsigned char board[], int pegs) {
+        vector<int> cells ;
+        for (int c=0; c<BOARD_SIZE; ++c)
+            if (board[c] == '0')
+                cells.push_back(c) ;
+        board[cells[below(cells.size())]] = '1' ;
+        int n = 1 ;
+        vector<int> undo ;
+        while (n < pegs) {
+            // A jump can be undone if its landing cell holds a peg and
+            // the jumped and origin cells are empty board cells
+            undo.clear() ;
+            for (int m=0; m<jumps.size(); m+=3)
+                if (board[jumps[m]] == '1' && board[jumps[m+1]] == '0' && board[jumps[m+2]] == '0')
+                    undo.push_back(m) ;
+            if (undo.empty())
+                break ;
+            int m = undo[below(undo.size())] ;
+            board[jumps[m]] = '0' ;
+            board[jumps[m+1]] = '1' ;
+            board[jumps[m+2]] = '1' ;
+            ++n ;
+        }
+        return n ;
+    }
+
+    // A board with a solution: play the game backwards from a single
+    // peg, keeping the attempt that got closest to the wanted pegs
+    void solvableBoard(unsigned char board[]) {
+        layout(board) ;
+        int cells = cellCount(board) ;
+        int pegs = int(pegDensity()*cells + 0.5) ;
+        if (pegs < 1)
+            pegs = 1 ;
+        if (pegs > cells-1)
+            pegs = cells-1 ;
+        unsigned char best[BOARD_SIZE] ;
+        int best_pegs = 0 ;
+        for (int t=0; t<TRIES && best_pegs < pegs; ++t) {
+            unsigned char attempt[BOARD_SIZE] ;
+            memcpy(attempt, board, BOARD_SIZE) ;
+            int n = reverseGame(attempt, pegs) ;
+            if (n > best_pegs) {
+                memcpy(best, attempt, BOARD_SIZE) ;
+                best_pegs = n ;
+            }
+        }
+        memcpy(board, best, BOARD_SIZE) ;
+    }
+
+    void next(unsigned char board[]) {
+        if (opt.solvable)
+            solvableBoard(board) ;
+        else
+            randomBoard(board) ;
+    }
+} ;
+
+// Make puzzle files for scaling experiments.  Boards are written as they
+// are made, so sets of any size can be streamed to a file or a pipe.
+int main(int argc, char *argv[]) {
+    generator_options opt ;
+    if (!parseOptions(argc, argv, opt)) {
+        cerr << "usage: " << argv[0] << " [--seed n] [--cells fraction] [--pegs fraction]"
+             << " [--mix easy:medium:hard] [--solvable] [--binary] count output" << endl ;
+        return -1 ;
+    }
+
+    puzzle_writer output ;
+    if (!output.Open(opt.output, opt.count, opt.binary)) {
+        cerr << "can't write " << opt.output << endl ;
+        return -1 ;
+    }
+    board_generator gen(opt) ;
+    unsigned char board[BOARD_SIZE] ;
+    for (unsigned long k=0; k<opt.count; ++k) {
+        gen.next(board) ;
+        output.Write(board) ;
+    }
+    if (!output.Close()) {
+        cerr << "failed to write " << opt.output << endl ;
+        return -1 ;
+    }
+    return 0 ;
+}
@@ -1,8 +1,17 @@
 #include "game.h"
+#include "search.h"
+#include "result.h"
+#include "bidir.h"
+#include "checkpoint.h"
+#include "puzzles.h"
+#include "service.h"
 #include "utilities.h"
+#include "profile.h"
 #include "string.h"
 // Standard Includes for MPI, C and OS calls
 #include <mpi.h>
+#include <stdlib.h>
+#include <unistd.h>
 
 // C++ standard I/O and library includes
 #include <iostream>
@@ -10,6 +19,10 @@
 #include <sstream>
 #include <vector>
 #include <string>
+#include <map>
+#include <list>
+#include <deque>
+#include <algorithm>
 
 // C++ stadard library using statements
 using std::cout ;
@@ -30,219 +43,1023 @@ const unsigned int TAG_SOLUTION = 2;        // Client tag telling server that so
 const unsigned int TAG_NO_SOLUTION = 3;     // Client tag telling server that no solution was found
 const unsigned int TAG_FINISHED = 4;        // Server tag telling all clients to end communication
 const unsigned int TAG_READY = 5;           // Client tag telling server it is ready for jobs
+const unsigned int TAG_SOLVE_PIECE = 6;     // Server tag telling client to search a piece of a puzzle
+const unsigned int TAG_SPLIT = 7;           // Server tag asking client to give away part of its search
+const unsigned int TAG_PIECE = 8;           // Client tag answering a split request
+const unsigned int TAG_CANCEL = 9;          // Server tag telling client its puzzle was solved elsewhere
 unsigned int BOARD_SIZE = IDIM*JDIM;        // Size of the game board
-MPI_Request request;                        // MPI request handle
-MPI_Status status;                          // MPI status handle
+const long STEP_NODES = 4096;               // Nodes searched between checks for messages
+const size_t BIDIR_STATES = 1<<22;          // States the bidirectional search may store
+const double SPLIT_RETRY = 0.01;            // Seconds before asking a client to split again
+const int MESSAGE_MAX_SIZE = sizeof(int)+FRONTIER_MAX_SIZE; // Largest message between processors
+const double SERVICE_WAIT = 0.001;          // Seconds the idle server waits for a board in --service mode
 
-// The server should delegate work to all the clients.
-// However, while the server is idle, it should also
-// do a puzzle to utilize the available resources wisely.
-void Server(int argc, char *argv[], int procs) {
+// Command line options, parsed identically on every processor
+struct options {
+    const char *input ;                     // Input case filename
+    const char *output ;                    // Output case filename
+    double time_limit ;                     // Seconds allowed per puzzle (0 means no limit)
+    bool count ;                            // Count all solutions of solved puzzles
+    int memo_mb ;                           // Size of the node shared memo table in MB
+    const char *endgame ;                   // Endgame database filename (optional)
+    int bidir_pegs ;                        // Boards with this many pegs use the bidirectional search
+    bool serverless ;                       // Processors claim puzzles themselves, no server
+    int chunk ;                             // Puzzles claimed at a time in serverless mode
+    int window ;                            // Puzzles started past the first unwritten one
+    const char *checkpoint ;                // Checkpoint filename (optional)
+    double checkpoint_interval ;            // Seconds between checkpoint writes
+    bool resume ;                           // Skip the puzzles finished in the checkpoint
+    const char *order_table ;               // Weights for the table move ordering
+    const char *order_save ;                // File to write the learned move weights to
+    bool profile ;                          // Print the time spent in each profile scope
+    const char *service ;                   // Serve boards from "-" or a Unix socket (optional)
+    options() : input(0), output(0), time_limit(0), count(false), memo_mb(64), endgame(0),
+                bidir_pegs(0), serverless(false), chunk(1), window(1024), checkpoint(0),
+                checkpoint_interval(30), resume(false), order_table(0), order_save(0),
+                profile(false), service(0) {}
+} ;
 
-    // Check to make sure the server can run
-    if(argc != 3) {
-        cerr << "two arguments please!" << endl ;
-        MPI_Abort(MPI_COMM_WORLD, -1);
+// Order in which the depth first search tries moves, and the
+// statistics of the solutions found by this processor
+move_order order(move_order::CENTER);
+
+// Parse the command line, returns false if it is not valid
+bool parseOptions(int argc, char *argv[], options &opt) {
+    int files = 0 ;
+    for (int i=1; i<argc; ++i) {
+        if (strcmp(argv[i], "--time-limit") == 0 && i+1 < argc) {
+            opt.time_limit = atof(argv[++i]) ;
+        }
+        else if (strcmp(argv[i], "--count") == 0) {
+            opt.count = true ;
+        }
+        else if (strcmp(argv[i], "--memo-mb") == 0 && i+1 < argc) {
+            opt.memo_mb = atoi(argv[++i]) ;
+        }
+        else if (strcmp(argv[i], "--endgame") == 0 && i+1 < argc) {
+            opt.endgame = argv[++i] ;
+        }
+        else if (strcmp(argv[i], "--bidir-pegs") == 0 && i+1 < argc) {
+            opt.bidir_pegs = atoi(argv[++i]) ;
+        }
+        else if (strcmp(argv[i], "--serverless") == 0) {
+            opt.serverless = true ;
+        }
+        else if (strcmp(argv[i], "--chunk") == 0 && i+1 < argc) {
+            opt.chunk = atoi(argv[++i]) ;
+            if (opt.chunk < 1)
+                return false ;
+        }
+        else if (strcmp(argv[i], "--window") == 0 && i+1 < argc) {
+            opt.window = atoi(argv[++i]) ;
+            if (opt.window < 1)
+                return false ;
+        }
+        else if (strcmp(argv[i], "--checkpoint") == 0 && i+1 < argc) {
+            opt.checkpoint = argv[++i] ;
+        }
+        else if (strcmp(argv[i], "--checkpoint-interval") == 0 && i+1 < argc) {
+            opt.checkpoint_interval = atof(argv[++i]) ;
+        }
+        else if (strcmp(argv[i], "--resume") == 0) {
+            opt.resume = true ;
+        }
+        else if (strcmp(argv[i], "--order") == 0 && i+1 < argc) {
+            if (!order.Select(argv[++i]))
+                return false ;
+        }
+        else if (strcmp(argv[i], "--order-table") == 0 && i+1 < argc) {
+            opt.order_table = argv[++i] ;
+        }
+        else if (strcmp(argv[i], "--order-save") == 0 && i+1 < argc) {
+            opt.order_save = argv[++i] ;
+        }
+        else if (strcmp(argv[i], "--profile") == 0) {
+            opt.profile = true ;
+        }
+        else if (strcmp(argv[i], "--service") == 0 && i+1 < argc) {
+            opt.service = argv[++i] ;
+        }
+        else if (argv[i][0] == '-' && argv[i][1] == '-') {
+            return false ;
+        }
+        else if (files == 0) {
+            opt.input = argv[i] ; ++files ;
+        }
+        else if (files == 1) {
+            opt.output = argv[i] ; ++files ;
+        }
+        else {
+            return false ;
+        }
+    }
+    // Checkpoints are kept by the server
+    if (opt.resume && !opt.checkpoint)
+        return false ;
+    if (opt.serverless && opt.checkpoint)
+        return false ;
+    // The table ordering needs its weights
+    if ((order.ordering() == move_order::TABLE) != (opt.order_table != 0))
+        return false ;
+    // The service takes its boards from the stream and answers one
+    // line per board, with the server handing them out
+    if (opt.service)
+        return files == 0 && !opt.serverless && !opt.checkpoint && !opt.count ;
+    return files == 2 ;
+}
+
+// Check whether a search has run past the per puzzle time limit
+bool timedOut(const options &opt, double start) {
+    return opt.time_limit > 0 && MPI_Wtime() - start > opt.time_limit ;
+}
+
+// Read the next board of the input file, a file that ends early or
+// holds something else stops the run
+void readPuzzle(const options &opt, puzzle_reader &input, unsigned char board[]) {
+    if (!input.Next(board)) {
+        cerr << "malformed puzzle file " << opt.input << endl ;
+        MPI_Abort(MPI_COMM_WORLD, -1) ;
     }
+}
 
-    ifstream input(argv[1],ios::in);    // Input case filename
-    ofstream output(argv[2],ios::out);  // Output case filename
+// Memo of solution counts, kept for the whole run
+solution_counter counter;
 
-    int received = 0;                   // Flag to catch if message received from client
-    unsigned int solutions = 0;         // Total number of solutions
-    unsigned int NUM_GAMES = 0 ;        // Total number of games read in from the file
-    input >> NUM_GAMES ;                // Get games from input file
-    int i = 0;                          // Game counter
+// States known to have no solution, shared by all processors on a node
+dead_table memo;
+
+// Solvability of states with few pegs, memory mapped from a file
+endgame_db endgame;
+
+// Work done on every finished puzzle: its solution is added to the
+// move ordering statistics, and in --count mode every solution of a
+// solved puzzle is counted along with the cells where its last peg
+// can finish
+void finishResult(const options &opt, solve_result &result) {
+    if (result.status != solve_result::SOLUTION)
+        return ;
+    order.Learn(result.solution, result.size);
+    if (!opt.count)
+        return ;
+    PROFILE_SCOPE("countSolutions") ;
+    game_state game_board;
+    game_board.Init(result.board);
+    result.count = counter.count(game_board);
+}
+
+// The search of a puzzle or of a piece of one.  Boards the heuristic
+// picks start with the bidirectional search, and the depth first search
+// takes over if that runs out of room.  Either way the search advances
+// a bounded number of nodes per step, so the caller can answer messages
+// and check the time limit in between.
+class puzzle_search {
+public:
+    puzzle_search() : bidirectional(false), bidir_nodes(0) {
+        dfs.setMemo(&memo) ;
+        dfs.setEndgame(&endgame) ;
+        dfs.setOrder(&order) ;
+    }
+    // Start a new search rooted at game state s
+    void Init(const options &opt, const game_state &s) {
+        bidir_nodes = 0 ;
+        bidirectional = preferBidirectional(s, opt.bidir_pegs) ;
+        if (bidirectional)
+            bidir.Init(s, BIDIR_STATES) ;
+        else
+            dfs.Init(s) ;
+    }
+    // Continue a piece of another processor's depth first search
+    bool Restore(const unsigned char *buf, int len) {
+        bidirectional = false ;
+        bidir_nodes = 0 ;
+        return dfs.Restore(buf, len) ;
+    }
+    // Expand at most node_budget nodes, returns true when the search is done
+    bool step(long node_budget) {
+        if (!bidirectional)
+            return dfs.step(node_budget) ;
+        if (!bidir.step(node_budget))
+            return false ;
+        if (bidir.result() >= 0)
+            return true ;
+        // Out of room, the states it generated still count
+        bidir_nodes = bidir.nodes() ;
+        bidirectional = false ;
+        dfs.Init(bidir.root()) ;
+        bidir.Free() ;
+        return false ;
+    }
+    // Give away part of the search, only the depth first search splits
+    bool Split(vector<unsigned char> &piece) {
+        return !bidirectional && dfs.Split(piece) ;
+    }
+    long nodes() const {
+        return bidir_nodes + (bidirectional ? bidir.nodes() : dfs.nodes()) ;
+    }
+    const game_state &root() const {
+        return bidirectional ? bidir.root() : dfs.root() ;
+    }
+    // Fill in the result from the search, finished or abandoned
+    void Record(solve_result &result) const {
+        if (bidirectional)
+            result.Record(bidir) ;
+        else
+            result.Record(dfs) ;
+        result.nodes += bidir_nodes ;
+    }
+private:
+    bidir_search bidir ;
+    dfs_search dfs ;
+    bool bidirectional ;                    // The bidirectional search is running
+    long bidir_nodes ;                      // Nodes of a bidirectional search that gave up
+} ;
+
+// Solve a whole puzzle on this processor, without help from the others
+void solvePuzzle(const options &opt, solve_result &result) {
+    PROFILE_SCOPE("solvePuzzle") ;
+    game_state game_board ;
+    game_board.Init(result.board) ;
+    puzzle_search search ;
+    search.Init(opt, game_board) ;
+    double start = MPI_Wtime() ;
+    while (!search.step(STEP_NODES) && !timedOut(opt, start))
+        ;
+    search.Record(result) ;
+    finishResult(opt, result) ;
+}
 
-    // For each game in the provided file, do the following...
-    while (i < NUM_GAMES){
+// Results gathered by the server.  Results arrive in the order the
+// puzzles finish and are held back until every earlier puzzle has been
+// written, so the output file follows the order of the input file.
+// The totals are reported at the end.
+struct result_log {
+    ofstream output ;                       // Output case file
+    unsigned int solutions ;                // Total number of solutions
+    unsigned int timeouts ;                 // Puzzles abandoned at the time limit
+    long long nodes ;                       // Nodes expanded over all puzzles
+    int next_task ;                         // First puzzle not yet written
+    std::map<int,solve_result> waiting ;    // Results of later puzzles
+    result_log(const char *filename) : solutions(0), timeouts(0), nodes(0), next_task(0) {
+        if (filename)
+            output.open(filename, ios::out) ;
+    }
+    void Record(const solve_result &result) {
+        if (result.task != next_task) {
+            waiting[result.task] = result ;
+            return ;
+        }
+        Write(result) ;
+        std::map<int,solve_result>::iterator it = waiting.begin() ;
+        while (it != waiting.end() && it->first == next_task) {
+            Write(it->second) ;
+            waiting.erase(it++) ;
+        }
+    }
+    // Write the result of the next puzzle in input order
+    void Write(const solve_result &result) {
+        if (result.status == solve_result::SOLUTION) {
+            result.Print(output) ;
+            ++solutions ;
+        }
+        else if (result.status == solve_result::TIMED_OUT)
+            ++timeouts ;
+        nodes += result.nodes ;
+        ++next_task ;
+    }
+    // Report how many cases had a solution
+    void Report() const {
+        cout << "found " << solutions << " solutions" << endl ;
+        cout << "nodes expanded = " << nodes << endl ;
+        if (timeouts > 0)
+            cout << timeouts << " puzzles exceeded the time limit" << endl ;
+    }
+} ;
 
-        unsigned char buffer[NUM_GAMES*BOARD_SIZE];
+// A send that is set up once and restarted for every message, for the
+// messages that always have the same size, destination and tag
+class persistent_send {
+public:
+    persistent_send() : request(MPI_REQUEST_NULL) {}
+    void Init(int len, int dest, int tag) {
+        data.assign(len, 0) ;
+        MPI_Send_init(&data[0], len, MPI_UNSIGNED_CHAR, dest, tag, MPI_COMM_WORLD, &request) ;
+    }
+    // The message buffer, waits for the previous send to complete
+    unsigned char *buffer() {
+        MPI_Wait(&request, MPI_STATUS_IGNORE) ;
+        return &data[0] ;
+    }
+    void Start() { MPI_Start(&request) ; }
+    void Free() {
+        if (request == MPI_REQUEST_NULL)
+            return ;
+        MPI_Wait(&request, MPI_STATUS_IGNORE) ;
+        MPI_Request_free(&request) ;
+    }
+private:
+    vector<unsigned char> data ;
+    MPI_Request request ;
+} ;
 
-        // Listen for message from any of the client procs
-        MPI_Irecv(buffer, NUM_GAMES*BOARD_SIZE, MPI_UNSIGNED_CHAR, MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &request);
-        MPI_Test(&request, &received, &status);
+// The server's persistent sends to one client
+struct client_channel {
+    persistent_send solve ;                 // TAG_SOLVE: task index and board
+    persistent_send split ;                 // TAG_SPLIT: task index
+    persistent_send cancel ;                // TAG_CANCEL: task index
+} ;
 
-        // While the server hasn't received anything, perform a job
-        while (!received && i < NUM_GAMES) {
+// A puzzle being solved.  Near the end of the run a puzzle can be split
+// into pieces that are searched on several processors at once.  A split
+// gives away the later part of a piece's depth first search, so the
+// pieces cover consecutive parts of the search tree and live keeps the
+// ones still searching in that order.  A solution cancels the pieces
+// after it, but the pieces before it go on and a solution they find
+// replaces it, so the puzzle gets the solution the depth first search
+// finds on one processor, however it was split.  The puzzle is finished
+// when every piece has reported back.
+struct task_state {
+    solve_result result ;                   // Board, solution and nodes searched so far
+    int pieces ;                            // Pieces not yet reported back
+    std::list<int> live ;                   // Pieces still searching, in search order
+    int next_piece ;                        // Id of the next piece split off
+    task_state() : pieces(0), next_piece(0) {}
+    bool isLive(int piece) const {
+        return std::find(live.begin(), live.end(), piece) != live.end() ;
+    }
+    // Add a piece split from piece from, which searches the part of the
+    // tree right after what from keeps
+    int addPiece(int from) {
+        std::list<int>::iterator p = std::find(live.begin(), live.end(), from) ;
+        live.insert(++p, next_piece) ;
+        ++pieces ;
+        return next_piece++ ;
+    }
+} ;
 
-            // Get the next line in the file
-            string input_string;
-            input >> input_string;
-            ++i;
+// Part of a puzzle's search waiting for a processor
+struct task_piece {
+    int task ;
+    int piece ;
+    vector<unsigned char> frontier ;        // Saved dfs_search (see dfs_search::Save)
+} ;
 
-            // Buffer to store current game board
-            unsigned char server_buffer[BOARD_SIZE];
-            for (int j=0; j<BOARD_SIZE; ++j)
-                server_buffer[j] = input_string[j];
+// The server's bookkeeping: which puzzles are being solved, who is
+// working on what, and the pieces of puzzles waiting to be handed out.
+struct dispatcher {
+    const options &opt ;
+    puzzle_reader input ;                   // Input case file (text or binary)
+    puzzle_service service ;                // Boards and results in --service mode
+    result_log log ;                        // Output case file
+    unsigned int NUM_GAMES ;                // Total number of games read in from the file
+    int next_game ;                         // Next game to read from the file
+    std::map<int,task_state> running ;      // Puzzles being solved
+    vector<int> working ;                   // Task each client works on (-1 when idle)
+    vector<int> working_piece ;             // and the piece of that task
+    vector<double> started ;                // When each client started its task
+    vector<bool> split_pending ;            // Client has been asked to split its search
+    vector<double> split_retry ;            // Don't ask a client to split again before this time
+    int pending_splits ;                    // Split requests not yet answered
+    vector<int> idle ;                      // Clients waiting for work
+    std::deque<task_piece> pieces ;         // Pieces waiting for a processor
+    vector<client_channel> channels ;       // Persistent sends to each client
+    checkpoint_log checkpoint ;             // Finished puzzles saved for a restart
+    vector<long> saved ;                    // Checkpoint offset of each puzzle finished
+                                            // by an earlier run, -1 for the others
+    puzzle_search local ;                   // The search the server works on itself
+    int local_task ;                        // Task of that search (-1 when none)
+    int local_piece ;
+    double local_start ;
 
-            // Solve a game
-            game_state game_board;
-            game_board.Init(server_buffer) ;
+    dispatcher(const options &o, int procs) : opt(o), log(o.output),
+        NUM_GAMES(0), next_game(0), working(procs,-1), working_piece(procs,-1), started(procs,0),
+        split_pending(procs,false), split_retry(procs,0), pending_splits(0), channels(procs),
+        local_task(-1), local_piece(-1), local_start(0) {
+        if (opt.service) {
+            if (!service.Open(opt.service)) {
+                cerr << "can't serve " << opt.service << endl ;
+                MPI_Abort(MPI_COMM_WORLD, -1) ;
+            }
+        }
+        else {
+            if (!input.Open(opt.input)) {
+                cerr << "can't read puzzle file " << opt.input << endl ;
+                MPI_Abort(MPI_COMM_WORLD, -1) ;
+            }
+            NUM_GAMES = input.size() ;      // Get games from input file
+        }
+        if (opt.checkpoint)
+            openCheckpoint() ;
+        for (int c=1; c<procs; ++c) {
+            channels[c].solve.Init(sizeof(int)+BOARD_SIZE, c, TAG_SOLVE) ;
+            channels[c].split.Init(sizeof(int), c, TAG_SPLIT) ;
+            channels[c].cancel.Init(sizeof(int), c, TAG_CANCEL) ;
+        }
+    }
 
-            move solution[BOARD_SIZE];
-            int size=0;
-            bool found = depthFirstSearch(game_board, size, solution);
+    // Start the checkpoint, or with --resume take the results saved
+    // by an earlier run and skip those puzzles
+    void openCheckpoint() {
+        bool ok = opt.resume ?
+            checkpoint.Resume(opt.checkpoint, NUM_GAMES, opt.checkpoint_interval, saved) :
+            checkpoint.Create(opt.checkpoint, NUM_GAMES, opt.checkpoint_interval) ;
+        if (!ok) {
+            cerr << "can't use checkpoint file " << opt.checkpoint << endl ;
+            MPI_Abort(MPI_COMM_WORLD, -1) ;
+        }
+        saved.resize(NUM_GAMES, -1) ;
+        int resumed = NUM_GAMES - std::count(saved.begin(), saved.end(), -1L) ;
+        if (resumed > 0)
+            cout << "resuming with " << resumed << " puzzles already finished" << endl ;
+        writeSaved() ;
+        skipFinished() ;
+    }
 
-            if (found) {
-                output << "found solution = " << endl;
-                game_state s;
-                s.Init(server_buffer);
-                s.Print(output);
-                for (int k=0; k<size; ++k) {
-                    s.makeMove(solution[k]);
-                    output << "-->" << endl;
-                    s.Print(output);
-                }
-                output << "solved" << endl;
-                ++solutions;
+    // Write out the saved results that are next in input order.  They
+    // are read from the checkpoint as their turn comes, so the results
+    // held back stay within the window.
+    void writeSaved() {
+        while (log.next_task < saved.size() && saved[log.next_task] >= 0) {
+            solve_result result ;
+            if (!checkpoint.Load(saved[log.next_task], result)) {
+                cerr << "can't read checkpoint file " << opt.checkpoint << endl ;
+                MPI_Abort(MPI_COMM_WORLD, -1) ;
             }
+            log.Record(result) ;
+        }
+    }
+
+    // Move past the puzzles in the file that an earlier run finished
+    void skipFinished() {
+        unsigned char board[IDIM*JDIM] ;
+        while (next_game < saved.size() && saved[next_game] >= 0) {
+            readPuzzle(opt, input, board) ;
+            ++next_game ;
+        }
+    }
 
-            // Check again
-            MPI_Test(&request, &received, &status);
+    // Release the persistent sends once every client is finished
+    void Free() {
+        for (int c=1; c<channels.size(); ++c) {
+            channels[c].solve.Free() ;
+            channels[c].split.Free() ;
+            channels[c].cancel.Free() ;
         }
+    }
+
+    // true while there is still work to do or hand out.  The service
+    // runs until no more boards will arrive.
+    bool busy() const {
+        bool more = opt.service ? !service.finished() : next_game < NUM_GAMES ;
+        return more || !running.empty() || pending_splits > 0 ;
+    }
+
+    // true if a new puzzle can be started.  Puzzles are not started
+    // more than opt.window past the first one whose result has not been
+    // written, which bounds the results held back by the log.
+    bool canStart() const {
+        if (opt.service)
+            return service.ready() ;
+        return next_game < NUM_GAMES && next_game < log.next_task + opt.window ;
+    }
 
-        // We have received something from a client proc,
-        // handle it.
-        if (received) {
+    // true if the server has a search of its own it can work on
+    bool localWork() const {
+        return local_task >= 0 || canStart() || !pieces.empty() ;
+    }
 
-            // What type of message and whom
-            // it came from.
-            int source = status.MPI_SOURCE;
-            int tag = status.MPI_TAG;
+    // Read the next puzzle from the file and register it as piece 0
+    int nextTask(unsigned char board[]) {
+        if (opt.service)
+            service.Next(board) ;
+        else
+            readPuzzle(opt, input, board) ;
+        int task = next_game++ ;
+        task_state &t = running[task] ;
+        t.result.task = task ;
+        memcpy(t.result.board, board, BOARD_SIZE) ;
+        t.pieces = 1 ;
+        t.live.push_back(t.next_piece++) ;
+        skipFinished() ;
+        return task ;
+    }
 
-            // If the client found a solution...
-            if (tag == TAG_SOLUTION) {
-                for (int k=0; k<sizeof(buffer); k++)
-                  cout << buffer[k];
-                ++solutions;
+    // A piece of a puzzle has been searched.  The results of pieces
+    // that were cancelled only add their nodes.
+    void pieceDone(const solve_result &result, int piece) {
+        std::map<int,task_state>::iterator it = running.find(result.task) ;
+        if (it == running.end())
+            return ;
+        task_state &t = it->second ;
+        --t.pieces ;
+        t.result.nodes += result.nodes ;
+        std::list<int>::iterator p = std::find(t.live.begin(), t.live.end(), piece) ;
+        if (p != t.live.end()) {
+            if (result.status == solve_result::SOLUTION) {
+                long nodes = t.result.nodes ;
+                t.result = result ;
+                t.result.nodes = nodes ;
+                cancelAfter(result.task, p) ;
             }
+            else if (result.status == solve_result::TIMED_OUT &&
+                     t.result.status != solve_result::SOLUTION)
+                t.result.status = solve_result::TIMED_OUT ;
+            t.live.erase(p) ;
+        }
+        if (t.pieces == 0) {
+            checkpoint.Add(t.result) ;
+            if (opt.service)
+                service.Reply(t.result) ;
+            else {
+                log.Record(t.result) ;
+                writeSaved() ;
+            }
+            running.erase(it) ;
+        }
+    }
 
-            // Get the next line in the file
-            string input_string;
-            input >> input_string;
-            ++i;
-
-            // Buffer to store current game board
-            memset(buffer, 0, BOARD_SIZE);
-            for (int j=0; j<BOARD_SIZE; ++j)
-                buffer[j] = input_string[j];
-
-            // Send another job to the client
-            int client_received = 0;
-            MPI_Isend(buffer, BOARD_SIZE, MPI_UNSIGNED_CHAR, source, TAG_SOLVE, MPI_COMM_WORLD, &request);
-            MPI_Test(&request, &client_received, &status);
-
-            // Make sure client receives job
-            // Do another job until then
-            while (!client_received && i < NUM_GAMES) {
-                string input_string;
-                input >> input_string;
-                ++i;
-
-                // Buffer to store current game board
-                unsigned char server_buffer[BOARD_SIZE];
-                for (int j=0; j<BOARD_SIZE; ++j)
-                    server_buffer[j] = input_string[j];
-
-                // Prep game board and solve another
-                game_state game_board;
-                game_board.Init(server_buffer);
-                move solution[BOARD_SIZE];
-                int size=0;
-                bool found = depthFirstSearch(game_board, size, solution);
-
-                // Add to the output stream
-                if (found) {
-                    output << "found solution = " << endl;
-                    game_state s;
-                    s.Init(server_buffer);
-                    s.Print(output);
-                    for (int i = 0; i < size; ++i) {
-                        s.makeMove(solution[i]);
-                        output << "-->" << endl;
-                        s.Print(output);
-                    }
-                    output << "solved" << endl;
-                    solutions++;
+    // Stop the pieces of a puzzle after piece solved, which found a solution
+    void cancelAfter(int task, std::list<int>::iterator solved) {
+        task_state &t = running[task] ;
+        std::list<int>::iterator first = solved ;
+        ++first ;
+        for (std::list<int>::iterator q=first; q!=t.live.end(); ++q)
+            for (int c=1; c<working.size(); ++c)
+                if (working[c] == task && working_piece[c] == *q) {
+                    memcpy(channels[c].cancel.buffer(), &task, sizeof(task)) ;
+                    channels[c].cancel.Start() ;
                 }
+        t.live.erase(first, t.live.end()) ;
+        for (std::deque<task_piece>::iterator w=pieces.begin(); w!=pieces.end();) {
+            if (w->task == task && !t.isLive(w->piece)) {
+                w = pieces.erase(w) ;
+                --t.pieces ;
+            }
+            else
+                ++w ;
+        }
+        // The server's own search is stopped in advanceLocal
+    }
+
+    // Send a task or a piece of one to a client.  Tasks go through the
+    // client's persistent send, pieces vary in size and are sent directly.
+    void send(int client, int tag, int task, int piece, const unsigned char *data, int len) {
+        if (tag == TAG_SOLVE) {
+            unsigned char *buffer = channels[client].solve.buffer() ;
+            memcpy(buffer, &task, sizeof(task)) ;
+            memcpy(buffer+sizeof(task), data, len) ;
+            channels[client].solve.Start() ;
+        }
+        else {
+            unsigned char buffer[MESSAGE_MAX_SIZE] ;
+            memcpy(buffer, &task, sizeof(task)) ;
+            memcpy(buffer+sizeof(task), data, len) ;
+            MPI_Send(buffer, sizeof(task)+len, MPI_UNSIGNED_CHAR, client, tag, MPI_COMM_WORLD) ;
+        }
+        working[client] = task ;
+        working_piece[client] = piece ;
+        started[client] = MPI_Wtime() ;
+    }
 
-                // Test again.
-                MPI_Test(&request, &client_received, &status);
+    // Give work to idle clients: new puzzles while they can be started, then
+    // pieces of the puzzles still being solved
+    void dispatch() {
+        PROFILE_SCOPE("dispatch") ;
+        while (!idle.empty()) {
+            int client = idle.back() ;
+            if (canStart()) {
+                unsigned char board[IDIM*JDIM] ;
+                int task = nextTask(board) ;
+                send(client, TAG_SOLVE, task, 0, board, BOARD_SIZE) ;
             }
-        } // End if received
+            else if (!pieces.empty()) {
+                task_piece &p = pieces.front() ;
+                send(client, TAG_SOLVE_PIECE, p.task, p.piece, &p.frontier[0], p.frontier.size()) ;
+                pieces.pop_front() ;
+            }
+            else if (!splitLocal())
+                break ;
+            else
+                continue ;
+            idle.pop_back() ;
+        }
+
+        // Ask the clients that have been working longest to split their
+        // search, one request for each idle client
+        double now = MPI_Wtime() ;
+        while (!canStart() && pending_splits < int(idle.size())) {
+            int best = -1 ;
+            for (int c=1; c<working.size(); ++c) {
+                if (working[c] < 0 || split_pending[c] || split_retry[c] > now)
+                    continue ;
+                std::map<int,task_state>::const_iterator it = running.find(working[c]) ;
+                if (it != running.end() && it->second.isLive(working_piece[c]) && (best < 0 || started[c] < started[best]))
+                    best = c ;
+            }
+            if (best < 0)
+                break ;
+            int task = working[best] ;
+            memcpy(channels[best].split.buffer(), &task, sizeof(task)) ;
+            channels[best].split.Start() ;
+            split_pending[best] = true ;
+            ++pending_splits ;
+        }
+    }
+
+    // Split the server's own search into a waiting piece
+    bool splitLocal() {
+        if (local_task < 0 || !running[local_task].isLive(local_piece))
+            return false ;
+        task_piece p ;
+        p.task = local_task ;
+        if (!local.Split(p.frontier))
+            return false ;
+        p.piece = running[local_task].addPiece(local_piece) ;
+        pieces.push_back(p) ;
+        return true ;
+    }
+
+    // Handle a message from a client
+    void receive(const MPI_Status &status, const unsigned char buffer[]) {
+        PROFILE_SCOPE("receive") ;
+        int source = status.MPI_SOURCE ;
+        int tag = status.MPI_TAG ;
+        int count ;
+        MPI_Get_count(&status, MPI_UNSIGNED_CHAR, &count) ;
+
+        if (tag == TAG_PIECE) {
+            // Answer to a split request, empty if the client had
+            // nothing to give away
+            split_pending[source] = false ;
+            --pending_splits ;
+            task_piece p ;
+            memcpy(&p.task, buffer, sizeof(p.task)) ;
+            std::map<int,task_state>::iterator it = running.find(p.task) ;
+            if (count > sizeof(p.task) && it != running.end() && it->second.isLive(working_piece[source])) {
+                p.frontier.assign(buffer+sizeof(p.task), buffer+count) ;
+                p.piece = it->second.addPiece(working_piece[source]) ;
+                pieces.push_back(p) ;
+            }
+            else
+                split_retry[source] = MPI_Wtime() + SPLIT_RETRY ;
+            return ;
+        }
+
+        // If the client sent back a result record it
+        if (tag == TAG_SOLUTION || tag == TAG_NO_SOLUTION) {
+            solve_result result ;
+            if (!result.Unpack(buffer, count)) {
+                cerr << "malformed result from processor " << source << endl ;
+                MPI_Abort(MPI_COMM_WORLD, -1) ;
+            }
+            pieceDone(result, working_piece[source]) ;
+        }
+        // The client is now waiting for work
+        working[source] = -1 ;
+        idle.push_back(source) ;
+    }
+
+    // Advance the server's own search, starting a new one if needed
+    void advanceLocal() {
+        PROFILE_SCOPE("advanceLocal") ;
+        if (local_task >= 0) {
+            solve_result result ;
+            result.task = local_task ;
+            local.root().SaveBoard(result.board) ;
+            if (!running[local_task].isLive(local_piece)) {
+                // An earlier piece of this puzzle found a solution
+                result.nodes = local.nodes() ;
+                pieceDone(result, local_piece) ;
+                local_task = -1 ;
+                return ;
+            }
+            bool done = local.step(STEP_NODES) ;
+            if (done || timedOut(opt, local_start)) {
+                local.Record(result) ;
+                finishResult(opt, result) ;
+                pieceDone(result, local_piece) ;
+                local_task = -1 ;
+            }
+        }
+
+        // Start on the next puzzle
+        else if (canStart()) {
+            unsigned char board[IDIM*JDIM] ;
+            int task = nextTask(board) ;
+            game_state game_board ;
+            game_board.Init(board) ;
+            local.Init(opt, game_board) ;
+            local_task = task ;
+            local_piece = 0 ;
+            local_start = MPI_Wtime() ;
+        }
+
+        // or on a piece of a puzzle being solved
+        else if (!pieces.empty()) {
+            task_piece &p = pieces.front() ;
+            if (!local.Restore(&p.frontier[0], p.frontier.size())) {
+                cerr << "malformed piece of puzzle " << p.task << endl ;
+                MPI_Abort(MPI_COMM_WORLD, -1) ;
+            }
+            local_task = p.task ;
+            local_piece = p.piece ;
+            local_start = MPI_Wtime() ;
+            pieces.pop_front() ;
+        }
+    }
+} ;
+
+// The server should delegate work to all the clients.
+// However, while the server is idle, it should also
+// do a puzzle to utilize the available resources wisely.
+// The server's own puzzle is searched a few thousand nodes
+// at a time so that clients never wait on it for work.
+// When the file runs out of puzzles, idle clients get
+// pieces of the puzzles that are still being searched.
+// Every client has a receive posted for it at all times, so
+// messages never arrive unexpected and one poll can pick up
+// messages from many clients.
+void Server(const options &opt, int procs) {
+
+    PROFILE_SCOPE("Server") ;
+    dispatcher server(opt, procs) ;
+    int clients = procs-1 ;
+
+    // One persistent receive per client, restarted after each message
+    vector<unsigned char> buffers(clients*MESSAGE_MAX_SIZE+1) ;
+    vector<MPI_Request> requests(clients+1) ;
+    vector<MPI_Status> statuses(clients+1) ;
+    vector<int> completed(clients+1) ;
+    for (int c=0; c<clients; ++c)
+        MPI_Recv_init(&buffers[c*MESSAGE_MAX_SIZE], MESSAGE_MAX_SIZE, MPI_UNSIGNED_CHAR, c+1, MPI_ANY_TAG,
+                      MPI_COMM_WORLD, &requests[c]) ;
+    if (clients > 0)
+        MPI_Startall(clients, &requests[0]) ;
+
+    // Continue until every game is solved and every client is waiting
+    while (server.busy() || server.idle.size() < clients) {
+
+        // Check for client messages, only block when the
+        // server has no puzzle of its own to work on
+        int received = 0 ;
+        if (clients > 0) {
+            if (server.localWork() || opt.service)
+                MPI_Testsome(clients, &requests[0], &received, &completed[0], &statuses[0]) ;
+            else {
+                PROFILE_SCOPE("wait for clients") ;
+                MPI_Waitsome(clients, &requests[0], &received, &completed[0], &statuses[0]) ;
+            }
+        }
+
+        // We have received something from client procs,
+        // handle it and listen for their next messages.
+        if (received > 0) {
+            for (int k=0; k<received; ++k) {
+                int c = completed[k] ;
+                server.receive(statuses[k], &buffers[c*MESSAGE_MAX_SIZE]) ;
+                MPI_Start(&requests[c]) ;
+            }
+            server.dispatch() ;
+            continue ;
+        }
+
+        // In service mode take the boards that have arrived, waiting
+        // a little for one when there is nothing else to do, and hand
+        // them to idle clients before the server takes one itself
+        if (opt.service) {
+            server.service.Poll(server.localWork() ? 0 : SERVICE_WAIT) ;
+            if (!server.idle.empty())
+                server.dispatch() ;
+        }
+
+        server.advanceLocal() ;
+        if (!server.idle.empty())
+            server.dispatch() ;
+        server.checkpoint.Flush(false) ;
     } // End NUM_GAMES while loop
+    server.checkpoint.Flush(true) ;
 
     // All games have been handled, end communication
     // between all client procs
-    for (int i=1; i<procs; i++) {
-        unsigned char buffer[1];
-        MPI_Isend(buffer, 0, MPI_UNSIGNED_CHAR, i, TAG_FINISHED, MPI_COMM_WORLD, &request);
-        MPI_Wait(&request, &status);
+    for (int c=0; c<clients; ++c) {
+        MPI_Cancel(&requests[c]) ;
+        MPI_Wait(&requests[c], MPI_STATUS_IGNORE) ;
+        MPI_Request_free(&requests[c]) ;
     }
+    for (int c=1; c<procs; ++c)
+        MPI_Send(0, 0, MPI_UNSIGNED_CHAR, c, TAG_FINISHED, MPI_COMM_WORLD) ;
+    server.Free() ;
 
-    // Report how cases had a solution.
-    cout << "found " << solutions << " solutions" << endl ;
+    if (!opt.service)
+        server.log.Report() ;
 }
 
-void Client() {
+void Client(const options &opt) {
+
+    PROFILE_SCOPE("Client") ;
+    // Messages from the server arrive in a persistent receive that is
+    // restarted once each message has been read.  Results go back
+    // through persistent sends of RESULT_MAX_SIZE bytes.
+    unsigned char buffer[MESSAGE_MAX_SIZE];
+    MPI_Request request;
+    MPI_Status status;
+    MPI_Recv_init(buffer, MESSAGE_MAX_SIZE, MPI_UNSIGNED_CHAR, 0, MPI_ANY_TAG, MPI_COMM_WORLD, &request);
+    persistent_send solution, no_solution;
+    solution.Init(RESULT_MAX_SIZE, 0, TAG_SOLUTION);
+    no_solution.Init(RESULT_MAX_SIZE, 0, TAG_NO_SOLUTION);
+    MPI_Start(&request);
 
     // When ready, send initial 'ready' tag to
     // begin communication with the server.
-    unsigned char buffer[BOARD_SIZE];
-    MPI_Isend(buffer, 0, MPI_UNSIGNED_CHAR, 0, TAG_READY, MPI_COMM_WORLD, &request);
-    MPI_Wait(&request, MPI_SUCCESS);
+    MPI_Send(0, 0, MPI_UNSIGNED_CHAR, 0, TAG_READY, MPI_COMM_WORLD);
 
     // Now that job has been received, continue to
     // do work until a 'finished' tag has been received.
     while (true) {
-        unsigned char buffer[BOARD_SIZE];
-
-        // Wait until game is fully received before trying to solve.
-        MPI_Irecv(buffer, BOARD_SIZE, MPI_UNSIGNED_CHAR, 0, MPI_ANY_TAG, MPI_COMM_WORLD, &request);
-        MPI_Wait(&request, &status);
+        {
+            PROFILE_SCOPE("wait for work") ;
+            MPI_Wait(&request, &status);
+        }
+        int tag = status.MPI_TAG;
+        int count;
+        MPI_Get_count(&status, MPI_UNSIGNED_CHAR, &count);
 
         // If 'finished' tag received, stop communication
-        if (status.MPI_TAG == TAG_FINISHED) { break; }
+        if (tag == TAG_FINISHED) { break; }
+
+        // A split request or cancel for a task that is already
+        // finished, the split request still needs an answer
+        if (tag == TAG_SPLIT)
+            MPI_Send(buffer, sizeof(int), MPI_UNSIGNED_CHAR, 0, TAG_PIECE, MPI_COMM_WORLD);
+        if (tag != TAG_SOLVE && tag != TAG_SOLVE_PIECE) {
+            MPI_Start(&request);
+            continue;
+        }
+
+        solve_result result;
+        memcpy(&result.task, buffer, sizeof(result.task));
+        puzzle_search search ;
 
         // Game received; initialize game board
-        game_state game_board ;
-        game_board.Init(buffer) ;
-
-        // If we find a solution to the game, put the results in solution
-        move solution[BOARD_SIZE] ;
-        int size = 0 ;
-        // Search for a solution to the puzzle
-        bool found = depthFirstSearch(game_board,size,solution) ;
-
-        // Add solution to stream and return to server.
-        if(found) {
-            stringstream output;
-            output << "found solution = " << endl;
-            game_state s;
-            s.Init(buffer);
-            s.Print(output);
-            for (int i = 0; i < size; ++i) {
-                s.makeMove(solution[i]);
-                output << "-->" << endl;
-                s.Print(output);
-            }
-            output << "solved" << endl;
-            string output_str = output.str();
-            int count = output_str.size();
-            // Convert stream to char array so MPI can handle
-            char *buffer = &output_str[0];
-            MPI_Isend(buffer, count, MPI_UNSIGNED_CHAR, 0, TAG_SOLUTION, MPI_COMM_WORLD, &request);
-            MPI_Wait(&request, MPI_SUCCESS);
-        }
-        // If no solution found, let the server know.
+        if (tag == TAG_SOLVE) {
+            memcpy(result.board, buffer+sizeof(result.task), BOARD_SIZE);
+            game_state game_board ;
+            game_board.Init(result.board) ;
+            search.Init(opt, game_board) ;
+        }
+        // or a piece of another processor's search
         else {
-            MPI_Isend(buffer, 0, MPI_UNSIGNED_CHAR, 0, TAG_NO_SOLUTION, MPI_COMM_WORLD, &request);
-            MPI_Wait(&request, MPI_SUCCESS);
+            if (!search.Restore(buffer+sizeof(result.task), count-sizeof(result.task))) {
+                cerr << "malformed piece of puzzle " << result.task << endl;
+                MPI_Abort(MPI_COMM_WORLD, -1);
+            }
+            search.root().SaveBoard(result.board);
+        }
+        MPI_Start(&request);
+
+        // Search for a solution to the puzzle, giving up if it runs
+        // past the time limit.  In between steps answer the server's
+        // requests to split the search or to cancel it.
+        double start = MPI_Wtime() ;
+        bool cancelled = false;
+        while (!search.step(STEP_NODES) && !timedOut(opt, start)) {
+            int flag;
+            MPI_Test(&request, &flag, &status);
+            if (!flag)
+                continue;
+            int task;
+            memcpy(&task, buffer, sizeof(task));
+            MPI_Start(&request);
+            if (status.MPI_TAG == TAG_SPLIT) {
+                unsigned char reply[MESSAGE_MAX_SIZE];
+                vector<unsigned char> piece;
+                memcpy(reply, &result.task, sizeof(result.task));
+                int len = sizeof(result.task);
+                if (task == result.task && search.Split(piece)) {
+                    memcpy(reply+len, &piece[0], piece.size());
+                    len += piece.size();
+                }
+                MPI_Send(reply, len, MPI_UNSIGNED_CHAR, 0, TAG_PIECE, MPI_COMM_WORLD);
+            }
+            else if (status.MPI_TAG == TAG_CANCEL && task == result.task) {
+                cancelled = true;
+                break;
+            }
         }
+        search.Record(result) ;
+        if (cancelled)
+            result.status = solve_result::NO_SOLUTION;
+        finishResult(opt, result) ;
+
+        // Return the result to the server.
+        persistent_send &reply = result.status == solve_result::SOLUTION ? solution : no_solution;
+        result.Pack(reply.buffer());
+        reply.Start();
     }
+
+    MPI_Request_free(&request);
+    solution.Free();
+    no_solution.Free();
 }
 
+// Serverless mode: every processor gets a copy of the puzzles and claims
+// the next chunk of them with an atomic add on a counter that lives in
+// processor 0's memory, so no processor waits on another for work.
+// Results are kept until the end and gathered to processor 0, which
+// writes them in the order of the input file.
+void Serverless(const options &opt, int rank, int procs) {
+
+    PROFILE_SCOPE("Serverless") ;
+    // Processor 0 reads the puzzles and broadcasts them
+    int num_games = 0 ;
+    vector<unsigned char> boards ;
+    if (rank == 0) {
+        puzzle_reader input ;
+        if (!input.Open(opt.input)) {
+            cerr << "can't read puzzle file " << opt.input << endl ;
+            MPI_Abort(MPI_COMM_WORLD, -1) ;
+        }
+        num_games = input.size() ;
+        boards.resize(num_games*BOARD_SIZE) ;
+        for (int g=0; g<num_games; ++g)
+            readPuzzle(opt, input, &boards[g*BOARD_SIZE]) ;
+    }
+    MPI_Bcast(&num_games, 1, MPI_INT, 0, MPI_COMM_WORLD) ;
+    boards.resize(num_games*BOARD_SIZE) ;
+    if (num_games > 0)
+        MPI_Bcast(&boards[0], boards.size(), MPI_UNSIGNED_CHAR, 0, MPI_COMM_WORLD) ;
+
+    // The index of the next unclaimed puzzle
+    int *next_game ;
+    MPI_Win win ;
+    MPI_Win_allocate(rank == 0 ? sizeof(int) : 0, sizeof(int), MPI_INFO_NULL, MPI_COMM_WORLD,
+                     &next_game, &win) ;
+    if (rank == 0)
+        *next_game = 0 ;
+    MPI_Barrier(MPI_COMM_WORLD) ;
+    MPI_Win_lock_all(0, win) ;
+
+    // Claim and solve chunks until the puzzles run out.  Each packed
+    // result is stored after a byte holding its length.
+    vector<unsigned char> packed ;
+    while (true) {
+        int first ;
+        {
+            PROFILE_SCOPE("claim") ;
+            MPI_Fetch_and_op(&opt.chunk, &first, MPI_INT, 0, 0, MPI_SUM, win) ;
+            MPI_Win_flush(0, win) ;
+        }
+        if (first >= num_games)
+            break ;
+        int last = std::min(first+opt.chunk, num_games) ;
+        for (int task=first; task<last; ++task) {
+            solve_result result ;
+            result.task = task ;
+            memcpy(result.board, &boards[task*BOARD_SIZE], BOARD_SIZE) ;
+            solvePuzzle(opt, result) ;
+            unsigned char buffer[RESULT_MAX_SIZE] ;
+            int len = result.Pack(buffer) ;
+            packed.push_back(len) ;
+            packed.insert(packed.end(), buffer, buffer+len) ;
+        }
+    }
+    MPI_Win_unlock_all(win) ;
+    MPI_Win_free(&win) ;
+
+    // Gather every processor's results on processor 0
+    PROFILE_SCOPE("gather") ;
+    int len = packed.size() ;
+    vector<int> lengths(procs), offsets(procs) ;
+    MPI_Gather(&len, 1, MPI_INT, &lengths[0], 1, MPI_INT, 0, MPI_COMM_WORLD) ;
+    vector<unsigned char> all ;
+    if (rank == 0) {
+        int total = 0 ;
+        for (int p=0; p<procs; ++p) {
+            offsets[p] = total ;
+            total += lengths[p] ;
+        }
+        all.resize(total+1) ;
+    }
+    packed.push_back(0) ;                   // Keeps &packed[0] valid when nothing was solved
+    MPI_Gatherv(&packed[0], len, MPI_UNSIGNED_CHAR, rank == 0 ? &all[0] : 0,
+                &lengths[0], &offsets[0], MPI_UNSIGNED_CHAR, 0, MPI_COMM_WORLD) ;
+    if (rank != 0)
+        return ;
+
+    // Write the results in the order of the input file
+    vector<solve_result> results(num_games) ;
+    for (size_t pos=0; pos+1<all.size(); pos += 1+all[pos]) {
+        solve_result result ;
+        if (!result.Unpack(&all[pos+1], all[pos]) || result.task < 0 || result.task >= num_games) {
+            cerr << "malformed result in serverless gather" << endl ;
+            MPI_Abort(MPI_COMM_WORLD, -1) ;
+        }
+        results[result.task] = result ;
+    }
+    result_log log(opt.output) ;
+    for (int g=0; g<num_games; ++g)
+        log.Record(results[g]) ;
+    log.Report() ;
+}
 
 int main(int argc, char *argv[]) {
     // This is a utility routine that installs an alarm to kill off this
@@ -260,15 +1077,74 @@ int main(int argc, char *argv[]) {
     MPI_Comm_size(MPI_COMM_WORLD,&procs) ;
     MPI_Comm_rank(MPI_COMM_WORLD,&rank) ;
 
-    if(rank == 0) {
+    // Check to make sure the program can run
+    options opt ;
+    if(!parseOptions(argc, argv, opt)) {
+        if(rank == 0)
+            cerr << "usage: " << argv[0] << " [--time-limit seconds] [--count] [--memo-mb MB] [--endgame database]"
+                 << " [--bidir-pegs pegs] [--serverless [--chunk puzzles]] [--window puzzles]"
+                 << " [--checkpoint file [--checkpoint-interval seconds] [--resume]]"
+                 << " [--order none|center|mobility|history|table] [--order-table file] [--order-save file]"
+                 << " [--profile] input output" << endl
+                 << "       " << argv[0] << " --service -|socket [--time-limit seconds] [--memo-mb MB]"
+                 << " [--endgame database] [--bidir-pegs pegs] [--order ...] [--profile]" << endl ;
+        MPI_Abort(MPI_COMM_WORLD, -1);
+    }
+
+    // A service runs until it is told to stop, so it must not be
+    // killed as a runaway job
+    if(opt.service)
+        alarm(0) ;
+
+    // The memo of dead states lives for the whole run
+    memo.Allocate(MPI_COMM_WORLD, opt.memo_mb) ;
+
+    if(opt.order_table && !order.Load(opt.order_table)) {
+        cerr << "can't read move order table " << opt.order_table << endl ;
+        MPI_Abort(MPI_COMM_WORLD, -1);
+    }
+
+    if(opt.endgame && !endgame.Open(opt.endgame)) {
+        cerr << "can't use endgame database " << opt.endgame << endl ;
+        MPI_Abort(MPI_COMM_WORLD, -1);
+    }
+
+    if(opt.serverless) {
+        // Every processor claims its own puzzles
+        double start = MPI_Wtime() ;
+        Serverless(opt,rank,procs) ;
+        if(rank == 0)
+            cout << "execution time = " << MPI_Wtime()-start << " seconds." << endl ;
+    }
+
+    else if(rank == 0) {
         // Processor 0 runs the server code
-        get_timer() ;// zero the timer
-        Server(argc,argv,procs) ;
+        double start = MPI_Wtime() ;
+        Server(opt,procs) ;
         // Measure the running time of the server
-        cout << "execution time = " << get_timer() << " seconds." << endl ;
+        if(!opt.service)
+            cout << "execution time = " << MPI_Wtime()-start << " seconds." << endl ;
     }
 
-    else { Client(); }
+    else { Client(opt); }
+
+    // Combine the solution statistics of every processor into a table
+    // for --order table
+    if(opt.order_save) {
+        double weights[MAX_MOVES] ;
+        MPI_Reduce(order.history(), weights, MAX_MOVES, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD) ;
+        if(rank == 0) {
+            memcpy(order.history(), weights, sizeof(weights)) ;
+            if(!order.Save(opt.order_save))
+                cerr << "can't write move order table " << opt.order_save << endl ;
+        }
+    }
+
+    // Where each processor spent its time
+    if(opt.profile)
+        profileReport(MPI_COMM_WORLD, opt.service ? cerr : cout) ;
+
+    memo.Free() ;
 
     // All MPI programs must call this before exiting
     MPI_Finalize() ;
@@ -0,0 +1,92 @@
+#include "memo.h"
+
+// Standard Includes for C calls
+#include <string.h>
+
+// Number of slots searched for a key before giving up
+const int PROBE_LIMIT = 8 ;
+
+void dead_table::Allocate(MPI_Comm comm, size_t megabytes) {
+  // Round the table down to a power of two number of slots
+  size_t nslots = 0 ;
+  if(megabytes > 0) {
+    nslots = 1 ;
+    while(nslots*2*sizeof(unsigned long long) <= megabytes<<20)
+      nslots *= 2 ;
+  }
+  if(nslots == 0)
+    return ;
+
+  // Processors that can share memory form a node communicator.  The
+  // first processor on each node allocates the whole table and the
+  // others map it.
+  MPI_Comm_split_type(comm,MPI_COMM_TYPE_SHARED,0,MPI_INFO_NULL,&node_comm) ;
+  int node_rank ;
+  MPI_Comm_rank(node_comm,&node_rank) ;
+  MPI_Aint bytes = node_rank==0?nslots*sizeof(unsigned long long):0 ;
+  void *base ;
+  MPI_Win_allocate_shared(bytes,sizeof(unsigned long long),MPI_INFO_NULL,
+                          node_comm,&base,&win) ;
+  MPI_Aint size ;
+  int disp ;
+  MPI_Win_shared_query(win,0,&size,&disp,&base) ;
+  slots = (unsigned long long *)base ;
+  mask = nslots-1 ;
+
+  // Open a passive target epoch for the whole run, the slots are then
+  // accessed directly with atomic loads and stores
+  MPI_Win_lock_all(MPI_MODE_NOCHECK,win) ;
+  if(node_rank == 0)
+    memset(slots,0,nslots*sizeof(unsigned long long)) ;
+  MPI_Win_sync(win) ;
+  MPI_Barrier(node_comm) ;
+  MPI_Win_sync(win) ;
+}
+
+void dead_table::Free() {
+  if(slots == 0)
+    return ;
+  MPI_Win_unlock_all(win) ;
+  MPI_Win_free(&win) ;
+  MPI_Comm_free(&node_comm) ;
+  slots = 0 ;
+}
+
+size_t dead_table::hash(unsigned long long key) const {
+  // splitmix64 finalizer, spreads the board bits over the whole word
+  key ^= key >> 30 ;
+  key *= 0xbf58476d1ce4e5b9ULL ;
+  key ^= key >> 27 ;
+  key *= 0x94d049bb133111ebULL ;
+  key ^= key >> 31 ;
+  return key & mask ;
+}
+
+bool dead_table::Lookup(unsigned long long key) const {
+  size_t h = hash(key) ;
+  for(int p=0;p<PROBE_LIMIT;++p) {
+    unsigned long long k = __atomic_load_n(&slots[(h+p)&mask],__ATOMIC_ACQUIRE) ;
+    if(k == key)
+      return true ;
+    if(k == 0)
+      return false ;
+  }
+  return false ;
+}
+
+void dead_table::Insert(unsigned long long key) {
+  size_t h = hash(key) ;
+  for(int p=0;p<PROBE_LIMIT;++p) {
+    unsigned long long *slot = &slots[(h+p)&mask] ;
+    unsigned long long k = __atomic_load_n(slot,__ATOMIC_ACQUIRE) ;
+    if(k == key)
+      return ;
+    // Claim an empty slot, if another processor wins the race check
+    // what it stored
+    if(k == 0 && __atomic_compare_exchange_n(slot,&k,key,false,
+                                             __ATOMIC_RELEASE,__ATOMIC_ACQUIRE))
+      return ;
+    if(k == key)
+      return ;
+  }
+}
@@ -0,0 +1,37 @@
+#ifndef MEMO_H
+#define MEMO_H
+
+// Standard Includes for MPI
+#include <mpi.h>
+#include <stddef.h>
+
+// A table of game states that are known to have no solution.  The table
+// is allocated in an MPI shared memory window, so every processor on the
+// same node shares one copy, and it is kept for the whole run.  Inserts
+// and lookups use atomic operations on the shared slots, so no locking is
+// needed.  The table is lossy: when the probe sequence for a key is full
+// the key is simply not stored.
+class dead_table {
+public:
+  dead_table() : slots(0), mask(0), win(MPI_WIN_NULL), node_comm(MPI_COMM_NULL) {}
+  // Collective over comm: allocate a table of about megabytes MB per node
+  // (0 disables the table)
+  void Allocate(MPI_Comm comm, size_t megabytes) ;
+  // Collective: release the table
+  void Free() ;
+  bool enabled() const { return slots != 0 ; }
+  // true if key (a packed game state) is known to have no solution
+  bool Lookup(unsigned long long key) const ;
+  // Record that key has no solution
+  void Insert(unsigned long long key) ;
+private:
+  // Index of the first slot probed for key
+  size_t hash(unsigned long long key) const ;
+
+  unsigned long long *slots ;
+  size_t mask ;
+  MPI_Win win ;
+  MPI_Comm node_comm ;
+} ;
+
+#endif
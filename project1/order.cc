@@ -0,0 +1,103 @@
+// C++ standard I/O and library includes
+#include <fstream>
+
+using std::ifstream ;
+using std::ofstream ;
+using std::ios ;
+using std::endl ;
+
+// Standard Includes for C calls
+#include <string.h>
+#include <stdlib.h>
+
+#include "order.h"
+
+static const unsigned char NO_KILLER = 0xff ;
+
+bool move_order::Select(const char *name) {
+  if(strcmp(name,"none") == 0)
+    kind = NONE ;
+  else if(strcmp(name,"center") == 0)
+    kind = CENTER ;
+  else if(strcmp(name,"mobility") == 0)
+    kind = MOBILITY ;
+  else if(strcmp(name,"history") == 0)
+    kind = HISTORY ;
+  else if(strcmp(name,"table") == 0)
+    kind = TABLE ;
+  else
+    return false ;
+  return true ;
+}
+
+double move_order::score(const game_state &s, const move &m, int depth) const {
+  switch(kind) {
+  case CENTER: {
+    // The move lands a peg on (m.i,m.j)
+    return -(abs(2*m.i-(IDIM-1))+abs(2*m.j-(JDIM-1))) ;
+  }
+  case MOBILITY: {
+    game_state child = s ;
+    child.makeMove(m) ;
+    move moves[MAX_MOVES] ;
+    return child.validMoveList(moves) ;
+  }
+  case HISTORY: {
+    const unsigned char p = m.Pack() ;
+    return (killer[depth] == p ? 1e30 : 0) + counts[p] ;
+  }
+  case TABLE:
+    return weights[m.Pack()] ;
+  default:
+    return 0 ;
+  }
+}
+
+void move_order::Sort(const game_state &s, move moves[], int n,
+                      int depth) const {
+  if(kind == NONE || n < 2)
+    return ;
+  double scores[MAX_MOVES] ;
+  for(int k=0;k<n;++k)
+    scores[k] = score(s,moves[k],depth) ;
+  // Insertion sort keeps equal moves in their original order
+  for(int k=1;k<n;++k) {
+    move m = moves[k] ;
+    double v = scores[k] ;
+    int l = k ;
+    for(;l>0 && scores[l-1] < v;--l) {
+      moves[l] = moves[l-1] ;
+      scores[l] = scores[l-1] ;
+    }
+    moves[l] = m ;
+    scores[l] = v ;
+  }
+}
+
+void move_order::Learn(const move solution[], int size) {
+  for(int k=0;k<size && k<IDIM*JDIM;++k) {
+    const unsigned char p = solution[k].Pack() ;
+    counts[p] += 1 ;
+    killer[k] = p ;
+  }
+}
+
+void move_order::Clear() {
+  for(int k=0;k<MAX_MOVES;++k)
+    counts[k] = weights[k] = 0 ;
+  memset(killer,NO_KILLER,sizeof(killer)) ;
+}
+
+bool move_order::Load(const char *filename) {
+  ifstream in(filename,ios::in) ;
+  for(int k=0;k<MAX_MOVES;++k)
+    in >> weights[k] ;
+  return bool(in) ;
+}
+
+bool move_order::Save(const char *filename) const {
+  ofstream out(filename,ios::out) ;
+  for(int k=0;k<MAX_MOVES;++k)
+    out << counts[k] << endl ;
+  return bool(out) ;
+}
@@ -0,0 +1,50 @@
+#ifndef ORDER_H
+#define ORDER_H
+
+#include "game.h"
+
+// Decides the order in which the depth first search tries the moves
+// from a state.  A solvable puzzle is proved as soon as one solution is
+// found, so trying the moves most likely to lead to a solution first
+// cuts the nodes expanded.  The orderings are:
+//   none      the order of validMoveList (row, column, direction)
+//   center    moves that land a peg closest to the center of the board
+//   mobility  moves that leave the most moves in the resulting state
+//   history   the move found at the same depth of the last solution
+//             (killer move), then moves by how often they appeared in
+//             solutions found so far in the run
+//   table     moves by a fixed table of weights, learned from the
+//             solutions of an earlier run (see Save)
+// The statistics used by history and written by Save are gathered from
+// every solution passed to Learn, whatever the ordering.
+class move_order {
+public:
+  enum order_kind {NONE,CENTER,MOBILITY,HISTORY,TABLE} ;
+  move_order(order_kind k = NONE) : kind(k) { Clear() ; }
+  // Select an ordering by name, returns false if the name is unknown
+  bool Select(const char *name) ;
+  order_kind ordering() const { return kind ; }
+  // Sort the n moves from s, best first.  depth is the number of moves
+  // made from the root of the search.
+  void Sort(const game_state &s, move moves[], int n, int depth) const ;
+  // Update the statistics with a solution of size moves
+  void Learn(const move solution[], int size) ;
+  // Reset the statistics
+  void Clear() ;
+  // Weight table file: one weight per move, in the order of move::Pack.
+  // Load replaces the table used by the table ordering; Save writes the
+  // number of times each move appeared in a solution.
+  bool Load(const char *filename) ;
+  bool Save(const char *filename) const ;
+  // Statistics of solution moves, indexed by move::Pack
+  double *history() { return counts ; }
+private:
+  double score(const game_state &s, const move &m, int depth) const ;
+
+  order_kind kind ;
+  double counts[MAX_MOVES] ;             // times each move was in a solution
+  double weights[MAX_MOVES] ;            // weights of the table ordering
+  unsigned char killer[IDIM*JDIM] ;      // move of the last solution at each depth
+} ;
+
+#endif
@@ -0,0 +1,236 @@
+#include "profile.h"
+
+#ifndef NO_PROFILE
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+
+using std::map ;
+using std::string ;
+using std::vector ;
+using std::ostream ;
+using std::istringstream ;
+using std::ostringstream ;
+
+// Calls are counted by time under 2^k microseconds, the last bucket
+// takes the rest
+const int PROFILE_BUCKETS = 32 ;
+
+struct profile_node {
+    const char *name ;
+    vector<int> children ;
+    long long calls ;
+    double time ;                           // Seconds over all calls
+    long long histogram[PROFILE_BUCKETS] ;
+    profile_node(const char *n) : name(n), calls(0), time(0) {
+        memset(histogram, 0, sizeof(histogram)) ;
+    }
+} ;
+
+// The scopes entered by one thread.  Node 0 is the root, which stands
+// for being in no scope.
+struct profile_thread {
+    vector<profile_node> nodes ;
+    int current ;                           // The innermost scope entered
+    profile_thread() : current(0) { nodes.push_back(profile_node("")) ; }
+
+    // The child of parent called name, added on first use
+    int child(int parent, const char *name) {
+        const vector<int> &children = nodes[parent].children ;
+        for (size_t k=0; k<children.size(); ++k) {
+            const char *n = nodes[children[k]].name ;
+            if (n == name || strcmp(n, name) == 0)
+                return children[k] ;
+        }
+        int c = nodes.size() ;
+        nodes.push_back(profile_node(name)) ;
+        nodes[parent].children.push_back(c) ;
+        return c ;
+    }
+} ;
+
+// Every thread's scopes, kept after the thread ends for the report
+static vector<profile_thread *> threads ;
+static std::mutex threads_lock ;
+static thread_local profile_thread *this_thread = 0 ;
+
+static profile_thread *threadProfile() {
+    if (this_thread == 0) {
+        this_thread = new profile_thread ;
+        std::lock_guard<std::mutex> guard(threads_lock) ;
+        threads.push_back(this_thread) ;
+    }
+    return this_thread ;
+}
+
+profile_scope::profile_scope(const char *name) : thread(threadProfile()) {
+    parent = thread->current ;
+    node = thread->child(parent, name) ;
+    thread->current = node ;
+    start = MPI_Wtime() ;
+}
+
+profile_scope::~profile_scope() {
+    double time = MPI_Wtime() - start ;
+    profile_node &n = thread->nodes[node] ;
+    ++n.calls ;
+    n.time += time ;
+    int bucket = 0 ;
+    for (double limit=1e-6; bucket < PROFILE_BUCKETS-1 && time >= limit; limit*=2)
+        ++bucket ;
+    ++n.histogram[bucket] ;
+    thread->current = parent ;
+}
+
+/******************************************************************************
+* The report.  Scopes are keyed by their path, the names of the scopes from  *
+* the outermost in, so a map lists every scope right after its parent.  Each *
+* processor merges its threads and sends its scopes to processor 0 as text,  *
+* one line with the path separated by tabs and one line with the totals.     *
+******************************************************************************/
+
+typedef vector<string> scope_path ;
+
+struct scope_totals {
+    int procs ;                             // Processors that entered the scope
+    long long calls ;
+    double min_time, max_time, sum_time ;   // Over the processors
+    long long histogram[PROFILE_BUCKETS] ;
+    scope_totals() : procs(0), calls(0), min_time(0), max_time(0), sum_time(0) {
+        memset(histogram, 0, sizeof(histogram)) ;
+    }
+    // Add the totals of one more processor
+    void Add(long long c, double time, const long long h[]) {
+        min_time = procs == 0 ? time : std::min(min_time, time) ;
+        max_time = procs == 0 ? time : std::max(max_time, time) ;
+        sum_time += time ;
+        calls += c ;
+        for (int k=0; k<PROFILE_BUCKETS; ++k)
+            histogram[k] += h[k] ;
+        ++procs ;
+    }
+} ;
+
+typedef map<scope_path, scope_totals> scope_map ;
+
+// Add node n of a thread and the scopes inside it to scopes
+static void mergeNode(const profile_thread &t, int n, scope_path &path, scope_map &scopes) {
+    const profile_node &node = t.nodes[n] ;
+    if (n != 0) {
+        path.push_back(node.name) ;
+        scope_totals &s = scopes[path] ;
+        s.calls += node.calls ;
+        s.sum_time += node.time ;
+        for (int k=0; k<PROFILE_BUCKETS; ++k)
+            s.histogram[k] += node.histogram[k] ;
+    }
+    for (size_t k=0; k<node.children.size(); ++k)
+        mergeNode(t, node.children[k], path, scopes) ;
+    if (n != 0)
+        path.pop_back() ;
+}
+
+// Label of the upper limit of histogram bucket k
+static string bucketLabel(int k) {
+    char label[32] ;
+    double us = double(1LL << k) ;
+    if (k == PROFILE_BUCKETS-1)
+        snprintf(label, sizeof(label), "more") ;
+    else if (us < 1e3)
+        snprintf(label, sizeof(label), "<%gus", us) ;
+    else if (us < 1e6)
+        snprintf(label, sizeof(label), "<%gms", us/1e3) ;
+    else
+        snprintf(label, sizeof(label), "<%gs", us/1e6) ;
+    return label ;
+}
+
+void profileReport(MPI_Comm comm, ostream &out) {
+    int procs, rank ;
+    MPI_Comm_size(comm, &procs) ;
+    MPI_Comm_rank(comm, &rank) ;
+
+    // The scopes of this processor's threads
+    scope_map local ;
+    {
+        std::lock_guard<std::mutex> guard(threads_lock) ;
+        scope_path path ;
+        for (size_t t=0; t<threads.size(); ++t)
+            mergeNode(*threads[t], 0, path, local) ;
+    }
+    ostringstream text ;
+    text.precision(17) ;
+    for (scope_map::const_iterator it=local.begin(); it!=local.end(); ++it) {
+        for (size_t k=0; k<it->first.size(); ++k)
+            text << (k > 0 ? "\t" : "") << it->first[k] ;
+        text << "\n" << it->second.calls << " " << it->second.sum_time ;
+        for (int k=0; k<PROFILE_BUCKETS; ++k)
+            text << " " << it->second.histogram[k] ;
+        text << "\n" ;
+    }
+    string mine = text.str() ;
+
+    // Gather the text of every processor on processor 0
+    int len = mine.size() ;
+    vector<int> lengths(procs), offsets(procs) ;
+    MPI_Gather(&len, 1, MPI_INT, &lengths[0], 1, MPI_INT, 0, comm) ;
+    vector<char> all(1) ;
+    if (rank == 0) {
+        int total = 0 ;
+        for (int p=0; p<procs; ++p) {
+            offsets[p] = total ;
+            total += lengths[p] ;
+        }
+        all.resize(total+1) ;
+    }
+    mine.push_back(0) ;                     // Keeps &mine[0] valid when there are no scopes
+    MPI_Gatherv(&mine[0], len, MPI_CHAR, &all[0], &lengths[0], &offsets[0], MPI_CHAR, 0, comm) ;
+    if (rank != 0)
+        return ;
+
+    scope_map scopes ;
+    for (int p=0; p<procs; ++p) {
+        istringstream in(string(&all[offsets[p]], lengths[p])) ;
+        string names, totals ;
+        while (getline(in, names) && getline(in, totals)) {
+            scope_path path ;
+            istringstream split(names) ;
+            string name ;
+            while (getline(split, name, '\t'))
+                path.push_back(name) ;
+            istringstream fields(totals) ;
+            long long calls, histogram[PROFILE_BUCKETS] ;
+            double time ;
+            fields >> calls >> time ;
+            for (int k=0; k<PROFILE_BUCKETS; ++k)
+                fields >> histogram[k] ;
+            scopes[path].Add(calls, time, histogram) ;
+        }
+    }
+
+    char line[256] ;
+    snprintf(line, sizeof(line), "%-40s %5s %12s %11s %11s %11s", "scope", "procs", "calls",
+             "min (s)", "mean (s)", "max (s)") ;
+    out << "profile of " << procs << " processors" << "\n" << line << "\n" ;
+    for (scope_map::const_iterator it=scopes.begin(); it!=scopes.end(); ++it) {
+        const scope_totals &s = it->second ;
+        int indent = 2*(it->first.size()-1) ;
+        snprintf(line, sizeof(line), "%*s%-*s %5d %12lld %11.6f %11.6f %11.6f", indent, "",
+                 std::max(1, 40-indent), it->first.back().c_str(), s.procs, s.calls,
+                 s.min_time, s.sum_time/s.procs, s.max_time) ;
+        out << line << "\n" << std::string(indent+2, ' ') << "calls" ;
+        for (int k=0; k<PROFILE_BUCKETS; ++k)
+            if (s.histogram[k] > 0)
+                out << " " << bucketLabel(k) << " " << s.histogram[k] ;
+        out << "\n" ;
+    }
+    out.flush() ;
+}
+
+#endif
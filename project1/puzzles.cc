@@ -0,0 +1,104 @@
+// C++ standard I/O and library includes
+#include <iostream>
+#include <fstream>
+#include <string>
+
+using std::string ;
+using std::ios ;
+
+// Standard Includes for C calls
+#include <string.h>
+
+#include "puzzles.h"
+
+static const char BINARY_MAGIC[4] = {'P','E','G','B'} ;
+
+bool puzzle_reader::Open(const char *filename) {
+  input.open(filename,ios::in|ios::binary) ;
+  if(!input)
+    return false ;
+  char magic[sizeof(BINARY_MAGIC)] ;
+  input.read(magic,sizeof(magic)) ;
+  binary = input && memcmp(magic,BINARY_MAGIC,sizeof(magic)) == 0 ;
+  if(binary)
+    input.read((char *)&count,sizeof(count)) ;
+  else {
+    input.clear() ;
+    input.seekg(0) ;
+    input >> count ;
+  }
+  read = 0 ;
+  if(!input)
+    count = 0 ;
+  return bool(input) ;
+}
+
+bool puzzle_reader::Next(unsigned char board[IDIM*JDIM]) {
+  if(read >= count)
+    return false ;
+  ++read ;
+  if(binary) {
+    unsigned long long key = 0 ;
+    input.read((char *)&key,sizeof(key)) ;
+    for(int c=0;c<IDIM*JDIM;++c) {
+      if(key & (1ULL << c))
+        board[c] = '1' ;
+      else if(key & (1ULL << (IDIM*JDIM+c)))
+        board[c] = '0' ;
+      else
+        board[c] = '2' ;
+    }
+  } else {
+    string s ;
+    input >> s ;
+    if(s.size() > IDIM*JDIM)
+      return false ;
+    for(int c=0;c<IDIM*JDIM;++c) {
+      board[c] = c < s.size() ? s[c] : '2' ;
+      if(board[c] < '0' || board[c] > '2')
+        return false ;
+    }
+  }
+  return bool(input) ;
+}
+
+bool puzzle_writer::Open(const char *filename, unsigned int count,
+                         bool bin) {
+  binary = bin ;
+  if(strcmp(filename,"-") == 0)
+    out = &std::cout ;
+  else {
+    file.open(filename,ios::out|ios::binary|ios::trunc) ;
+    out = &file ;
+  }
+  if(binary) {
+    out->write(BINARY_MAGIC,sizeof(BINARY_MAGIC)) ;
+    out->write((const char *)&count,sizeof(count)) ;
+  } else
+    *out << count << '\n' ;
+  return bool(*out) ;
+}
+
+void puzzle_writer::Write(const unsigned char board[IDIM*JDIM]) {
+  if(binary) {
+    unsigned long long key = 0 ;
+    for(int c=0;c<IDIM*JDIM;++c) {
+      if(board[c] == '1')
+        key |= 1ULL << c ;
+      else if(board[c] == '0')
+        key |= 1ULL << (IDIM*JDIM+c) ;
+    }
+    out->write((const char *)&key,sizeof(key)) ;
+  } else {
+    out->write((const char *)board,IDIM*JDIM) ;
+    out->put('\n') ;
+  }
+}
+
+bool puzzle_writer::Close() {
+  out->flush() ;
+  bool ok = bool(*out) ;
+  if(file.is_open())
+    file.close() ;
+  return ok ;
+}
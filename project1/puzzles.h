@@ -0,0 +1,57 @@
+#ifndef PUZZLES_H
+#define PUZZLES_H
+
+// C++ standard I/O and library includes
+#include <iostream>
+#include <fstream>
+
+#include "game.h"
+
+// Puzzle files come in two formats.  The text format is the number of
+// puzzles followed by one board per line, IDIM*JDIM characters each:
+// '0' for a hole, '1' for a peg and '2' for a cell that is not part of
+// the board (missing characters at the end of a line are '2').  The
+// binary format, written by the generator for large sets, is
+//   char               magic[4]      "PEGB"
+//   unsigned           count         number of puzzles
+//   unsigned long long board[count]  bit c set for a peg in cell c and
+//                                    bit IDIM*JDIM+c for a hole (the
+//                                    layout of game_state::Pack)
+// in native byte order.  Boards are always handed out in the text
+// characters.
+
+// Reads a puzzle file in either format, one board at a time
+class puzzle_reader {
+public:
+  puzzle_reader() : binary(false), count(0), read(0) {}
+  // Open a puzzle file, returns false if it can't be read
+  bool Open(const char *filename) ;
+  // Number of puzzles in the file
+  unsigned int size() const { return count ; }
+  // Read the next board, returns false when there are no more or the
+  // file ends early or holds something that is not a board
+  bool Next(unsigned char board[IDIM*JDIM]) ;
+private:
+  std::ifstream input ;
+  bool binary ;
+  unsigned int count ;
+  unsigned int read ;
+} ;
+
+// Writes a puzzle file in either format, one board at a time, so that
+// boards can be streamed out as they are made
+class puzzle_writer {
+public:
+  puzzle_writer() : out(0), binary(false) {}
+  // Start a file holding count boards, "-" writes to standard output
+  bool Open(const char *filename, unsigned int count, bool binary) ;
+  void Write(const unsigned char board[IDIM*JDIM]) ;
+  // Finish the file, returns false if anything failed to write
+  bool Close() ;
+private:
+  std::ofstream file ;
+  std::ostream *out ;
+  bool binary ;
+} ;
+
+#endif
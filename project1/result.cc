@@ -0,0 +1,108 @@
+// C++ standard I/O and library includes
+#include <iostream>
+#include <string.h>
+
+using std::endl ;
+
+#include "result.h"
+
+void solve_result::Record(const dfs_search &search) {
+  if(search.is_done())
+    status = search.result()?SOLUTION:NO_SOLUTION ;
+  else
+    status = TIMED_OUT ;
+  size = search.solution(solution) ;
+  nodes = search.nodes() ;
+}
+
+void solve_result::Record(const bidir_search &search) {
+  if(search.is_done())
+    status = search.result() == 1?SOLUTION:NO_SOLUTION ;
+  else
+    status = TIMED_OUT ;
+  size = search.solution(solution) ;
+  nodes = search.nodes() ;
+}
+
+int solve_result::Pack(unsigned char buf[RESULT_MAX_SIZE]) const {
+  int pos = 0 ;
+  memcpy(buf+pos,&task,sizeof(task)) ;
+  pos += sizeof(task) ;
+  memcpy(buf+pos,board,IDIM*JDIM) ;
+  pos += IDIM*JDIM ;
+  buf[pos++] = status ;
+  buf[pos++] = size ;
+  for(int k=0;k<size;++k)
+    buf[pos++] = solution[k].Pack() ;
+  long long n = nodes ;
+  memcpy(buf+pos,&n,sizeof(n)) ;
+  pos += sizeof(n) ;
+  memcpy(buf+pos,&count.paths,sizeof(count.paths)) ;
+  pos += sizeof(count.paths) ;
+  memcpy(buf+pos,&count.finals,sizeof(count.finals)) ;
+  pos += sizeof(count.finals) ;
+  return pos ;
+}
+
+bool solve_result::Unpack(const unsigned char *buf, int len) {
+  if(len < int(sizeof(task))+IDIM*JDIM+2)
+    return false ;
+  int pos = 0 ;
+  memcpy(&task,buf+pos,sizeof(task)) ;
+  pos += sizeof(task) ;
+  memcpy(board,buf+pos,IDIM*JDIM) ;
+  pos += IDIM*JDIM ;
+  if(buf[pos] > TIMED_OUT || buf[pos+1] > MAX_DEPTH)
+    return false ;
+  status = result_status(buf[pos++]) ;
+  size = buf[pos++] ;
+  if(len < pos+size+int(sizeof(long long)+sizeof(count.paths)+sizeof(count.finals)))
+    return false ;
+  for(int k=0;k<size;++k) {
+    if(buf[pos] >= MAX_MOVES)
+      return false ;
+    solution[k].Unpack(buf[pos++]) ;
+  }
+  long long n ;
+  memcpy(&n,buf+pos,sizeof(n)) ;
+  pos += sizeof(n) ;
+  nodes = n ;
+  memcpy(&count.paths,buf+pos,sizeof(count.paths)) ;
+  pos += sizeof(count.paths) ;
+  memcpy(&count.finals,buf+pos,sizeof(count.finals)) ;
+  return true ;
+}
+
+std::ostream &solve_result::Print(std::ostream &s) const {
+  if(status != SOLUTION)
+    return s ;
+  unsigned char buf[IDIM*JDIM] ;
+  memcpy(buf,board,IDIM*JDIM) ;
+  game_state g ;
+  g.Init(buf) ;
+  s << "found solution = " << endl ;
+  g.Print(s) ;
+  for(int k=0;k<size;++k) {
+    g.makeMove(solution[k]) ;
+    s << "-->" << endl ;
+    g.Print(s) ;
+  }
+  s << "solved" << endl ;
+  if(count.paths > 0) {
+    // iostreams cannot print 128 bit integers, so convert by hand
+    char digits[40] ;
+    int nd = 0 ;
+    for(unsigned __int128 p=count.paths;p>0;p/=10)
+      digits[nd++] = '0'+int(p%10) ;
+    s << "solution paths = " ;
+    while(nd > 0)
+      s << digits[--nd] ;
+    s << endl << "final pegs =" ;
+    for(int i=0;i<IDIM;++i)
+      for(int j=0;j<JDIM;++j)
+        if(count.finals & (1u << (j+i*JDIM)))
+          s << " (" << i << "," << j << ")" ;
+    s << endl ;
+  }
+  return s ;
+}
@@ -0,0 +1,42 @@
+#ifndef RESULT_H
+#define RESULT_H
+
+// C++ standard I/O and library includes
+#include <iostream>
+
+#include "game.h"
+#include "search.h"
+#include "bidir.h"
+
+// Largest message produced by solve_result::Pack
+#define RESULT_MAX_SIZE (4+IDIM*JDIM+2+MAX_DEPTH+8+16+4)
+
+// This structure records the outcome of solving one puzzle.  It is what
+// clients send back to the server, packed into a compact byte message,
+// and what the server writes into the solution file.
+struct solve_result {
+  enum result_status {NO_SOLUTION,SOLUTION,TIMED_OUT} ;
+  int task ;                        // index of the puzzle in the input
+  unsigned char board[IDIM*JDIM] ;  // starting board in file format
+  result_status status ;
+  int size ;                        // number of moves in solution
+  move solution[MAX_DEPTH] ;
+  long nodes ;                      // nodes expanded by the search
+  solution_count count ;            // all solutions (only in --count mode)
+  solve_result() : task(-1), status(NO_SOLUTION), size(0), nodes(0) {}
+  // Fill in the result from a finished (or abandoned) search
+  void Record(const dfs_search &search) ;
+  void Record(const bidir_search &search) ;
+  // Pack the result into buf and return the number of bytes used
+  int Pack(unsigned char buf[RESULT_MAX_SIZE]) const ;
+  // Unpack a message made by Pack, returns false if it is malformed.
+  // Bytes after the packed result are ignored, so results can travel in
+  // fixed size messages of RESULT_MAX_SIZE bytes.
+  bool Unpack(const unsigned char *buf, int len) ;
+  // Write the solution in the solution file format (nothing is written
+  // for puzzles without a solution).  When solutions were counted the
+  // number of solution paths and the possible final cells follow.
+  std::ostream &Print(std::ostream &s) const ;
+} ;
+
+#endif
@@ -0,0 +1,251 @@
+// C++ standard I/O and library includes
+#include <vector>
+
+using std::vector ;
+
+#include "search.h"
+#include "profile.h"
+
+void dfs_search::Init(const game_state &s) {
+  start = s ;
+  depth = 0 ;
+  expanded = 0 ;
+  found = false ;
+  done = false ;
+  stack[0].board = s ;
+  ntail = 0 ;
+  layout = endgame?endgame->findLayout(s):-1 ;
+  if(memo && memo->Lookup(s.Pack())) {
+    done = true ;
+    return ;
+  }
+  if(endgameKnows(s)) {
+    done = true ;
+    return ;
+  }
+  if(!expand()) {
+    done = true ;
+    found = s.Winner() ;
+  }
+}
+
+// Generate the moves for the game state at the top of the stack.  If
+// there are moves the state becomes a new level of the search tree,
+// otherwise it is a leaf and false is returned.
+bool dfs_search::expand() {
+  frame &f = stack[depth] ;
+  f.nmoves = f.board.validMoveList(f.moves) ;
+  if(order)
+    order->Sort(f.board,f.moves,f.nmoves,depth) ;
+  f.next = 0 ;
+  f.complete = true ;
+  ++expanded ;
+  if(f.nmoves == 0)
+    return false ;
+  ++depth ;
+  return true ;
+}
+
+bool dfs_search::endgameKnows(const game_state &s) {
+  if(layout < 0)
+    return false ;
+  const int known = endgame->Lookup(layout,s) ;
+  if(known < 0)
+    return false ;
+  if(known == 1) {
+    ntail = endgame->Solve(layout,s,tail) ;
+    found = true ;
+    done = true ;
+  }
+  return true ;
+}
+
+bool dfs_search::step(long node_budget) {
+  PROFILE_SCOPE("dfs_search::step") ;
+  long n = 0 ;
+  while(!done && n < node_budget) {
+    frame &f = stack[depth-1] ;
+    if(f.next == f.nmoves) {
+      // Every move from this state failed, so backtrack
+      if(memo && f.complete)
+        memo->Insert(f.board.Pack()) ;
+      if(--depth == 0)
+        done = true ;
+      continue ;
+    }
+    frame &child = stack[depth] ;
+    child.board = f.board ;
+    child.board.makeMove(f.moves[f.next++]) ;
+    ++n ;
+    if(memo && memo->Lookup(child.board.Pack()))
+      continue ;
+    // Once few enough pegs are left the database has the answer
+    if(endgameKnows(child.board))
+      continue ;
+    if(!expand() && child.board.Winner()) {
+      found = true ;
+      done = true ;
+    }
+  }
+  return done ;
+}
+
+int dfs_search::solution(move solution[]) const {
+  if(!found)
+    return 0 ;
+  // The winning leaf is not pushed, so every level on the stack records
+  // the move that leads towards it
+  for(int k=0;k<depth;++k)
+    solution[k] = stack[k].moves[stack[k].next-1] ;
+  // followed by the moves from the endgame database
+  for(int k=0;k<ntail;++k)
+    solution[depth+k] = tail[k] ;
+  return depth+ntail ;
+}
+
+void dfs_search::Save(vector<unsigned char> &buf) const {
+  buf.clear() ;
+  unsigned char board[IDIM*JDIM] ;
+  start.SaveBoard(board) ;
+  buf.insert(buf.end(),board,board+IDIM*JDIM) ;
+  buf.push_back(done?0:depth) ;
+  if(done)
+    return ;
+  for(int k=0;k<depth;++k) {
+    const frame &f = stack[k] ;
+    // The top level has no move in progress, only untried moves
+    buf.push_back(k+1<depth?f.moves[f.next-1].Pack():0xff) ;
+    buf.push_back(f.nmoves-f.next) ;
+    for(int m=f.next;m<f.nmoves;++m)
+      buf.push_back(f.moves[m].Pack()) ;
+  }
+}
+
+bool dfs_search::Restore(const unsigned char *buf, int len) {
+  if(len < IDIM*JDIM+1)
+    return false ;
+  unsigned char board[IDIM*JDIM] ;
+  for(int i=0;i<IDIM*JDIM;++i)
+    board[i] = buf[i] ;
+  start.Init(board) ;
+  layout = endgame?endgame->findLayout(start):-1 ;
+  ntail = 0 ;
+  depth = buf[IDIM*JDIM] ;
+  expanded = 0 ;
+  found = false ;
+  done = (depth == 0) ;
+  if(depth > MAX_DEPTH)
+    return false ;
+  int pos = IDIM*JDIM+1 ;
+  stack[0].board = start ;
+  for(int k=0;k<depth;++k) {
+    frame &f = stack[k] ;
+    if(pos+2 > len)
+      return false ;
+    unsigned char taken = buf[pos++] ;
+    int nrem = buf[pos++] ;
+    if(pos+nrem > len || nrem >= MAX_MOVES || (taken == 0xff) != (k+1 == depth))
+      return false ;
+    if(taken != 0xff && taken >= MAX_MOVES)
+      return false ;
+    for(int m=0;m<nrem;++m)
+      if(buf[pos+m] >= MAX_MOVES)
+        return false ;
+    f.nmoves = 0 ;
+    f.complete = false ;
+    if(taken != 0xff)
+      f.moves[f.nmoves++].Unpack(taken) ;
+    f.next = f.nmoves ;
+    for(int m=0;m<nrem;++m)
+      f.moves[f.nmoves++].Unpack(buf[pos++]) ;
+    for(int m=0;m<f.nmoves;++m)
+      if(!f.board.validMove(f.moves[m]))
+        return false ;
+    if(taken != 0xff) {
+      stack[k+1].board = f.board ;
+      stack[k+1].board.makeMove(f.moves[0]) ;
+    }
+  }
+  return pos == len ;
+}
+
+solution_count solution_counter::count(const game_state &s) {
+  // Start over rather than let the memo grow without bound
+  if(memo.size() > memo_limit)
+    memo.clear() ;
+  return countState(s) ;
+}
+
+solution_count solution_counter::countState(const game_state &s) {
+  const unsigned long long key = s.Pack() ;
+  std::unordered_map<unsigned long long,solution_count>::const_iterator
+    it = memo.find(key) ;
+  if(it != memo.end())
+    return it->second ;
+
+  solution_count c ;
+  move moves[MAX_MOVES] ;
+  const int nmoves = s.validMoveList(moves) ;
+  if(nmoves == 0) {
+    if(s.Winner()) {
+      c.paths = 1 ;
+      for(int i=0;i<IDIM*JDIM;++i)
+        if(s.board[i] == game_state::PEG)
+          c.finals |= 1u << i ;
+    }
+  } else {
+    for(int m=0;m<nmoves;++m) {
+      game_state child = s ;
+      child.makeMove(moves[m]) ;
+      solution_count cc = countState(child) ;
+      c.paths += cc.paths ;
+      c.finals |= cc.finals ;
+    }
+  }
+  memo[key] = c ;
+  return c ;
+}
+
+bool dfs_search::Split(vector<unsigned char> &piece) {
+  if(done)
+    return false ;
+  int k = 0 ;
+  while(k < depth && stack[k].next == stack[k].nmoves)
+    ++k ;
+  if(k == depth)
+    return false ;
+  frame &f = stack[k] ;
+  const int give = f.next+(f.nmoves-f.next)/2 ;
+
+  // The piece is the path down to level k followed by the moves given
+  // away at that level
+  piece.clear() ;
+  unsigned char board[IDIM*JDIM] ;
+  start.SaveBoard(board) ;
+  piece.insert(piece.end(),board,board+IDIM*JDIM) ;
+  piece.push_back(k+1) ;
+  for(int l=0;l<k;++l) {
+    piece.push_back(stack[l].moves[stack[l].next-1].Pack()) ;
+    piece.push_back(0) ;
+  }
+  piece.push_back(0xff) ;
+  piece.push_back(f.nmoves-give) ;
+  for(int m=give;m<f.nmoves;++m)
+    piece.push_back(f.moves[m].Pack()) ;
+  f.nmoves = give ;
+
+  // The levels above the split no longer search their whole subtree, so
+  // exhausting them proves nothing
+  for(int l=0;l<=k;++l)
+    stack[l].complete = false ;
+  return true ;
+}
+
+bool depthFirstSearch(const game_state &s, int &size, move solution[]) {
+  dfs_search search(s) ;
+  while(!search.step(1<<20))
+    ;
+  if(search.result())
+    size += search.solution(solution+size) ;
+  return search.result() ;
+}
@@ -0,0 +1,127 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+// C++ standard I/O and library includes
+#include <vector>
+#include <unordered_map>
+
+#include "game.h"
+#include "memo.h"
+#include "endgame.h"
+#include "order.h"
+
+// Upper bound on the depth of the search tree (every move removes a peg)
+#define MAX_DEPTH (IDIM*JDIM)
+
+// Upper bound on the size of a frontier written by dfs_search::Save
+#define FRONTIER_MAX_SIZE (IDIM*JDIM+1+MAX_DEPTH*(2+MAX_MOVES))
+
+// This class performs the same depth first search as depthFirstSearch,
+// but keeps the search tree on an explicit stack instead of the call
+// stack.  This allows the search to be advanced a bounded number of nodes
+// at a time, so that the caller can service messages or enforce a time
+// limit in between steps.  The unexplored frontier can also be saved to
+// a buffer and restored later (possibly on another processor).
+class dfs_search {
+public:
+  dfs_search() : memo(0), endgame(0), order(0), layout(-1), ntail(0), depth(0),
+                 done(true), found(false), expanded(0) {}
+  dfs_search(const game_state &s) : memo(0), endgame(0), order(0) { Init(s) ; }
+  // Use table to skip states known to have no solution, and record the
+  // states this search proves have none
+  void setMemo(dead_table *table) { memo = table && table->enabled()?table:0 ; }
+  // Use the endgame database to finish the search once a state has few
+  // enough pegs.  Must be set before Init.
+  void setEndgame(const endgame_db *db) { endgame = db && db->enabled()?db:0 ; }
+  // Try the moves from each state in the order chosen by o, instead of
+  // the order of validMoveList
+  void setOrder(const move_order *o) { order = o ; }
+  // Start a new search rooted at game state s
+  void Init(const game_state &s) ;
+  // Expand at most node_budget nodes of the search tree.  Returns true
+  // when the search is done.
+  bool step(long node_budget) ;
+  // The search is done when a solution is found or the tree is exhausted
+  bool is_done() const { return done ; }
+  // true if the search found a solution
+  bool result() const { return found ; }
+  // Copy the moves of the solution into solution and return how many
+  int solution(move solution[]) const ;
+  // The number of nodes expanded so far
+  long nodes() const { return expanded ; }
+  // The game state the search started from
+  const game_state &root() const { return start ; }
+  // Write the unexplored frontier into buf.  The format is the root
+  // board followed by, for each level of the stack, the move taken to
+  // reach the next level and the list of moves not yet tried.
+  void Save(std::vector<unsigned char> &buf) const ;
+  // Restore a search saved with Save, returns false if buf is malformed
+  bool Restore(const unsigned char *buf, int len) ;
+  // Give away part of the unexplored frontier, so another processor can
+  // help with this search.  The later half of the untried moves at the
+  // shallowest level that has any are removed from this search and
+  // written to piece in the Save format.  Returns false if there is
+  // nothing left to give away.
+  bool Split(std::vector<unsigned char> &piece) ;
+private:
+  // One level of the search tree: a game state, the moves available from
+  // it and the index of the next move to try.  A frame is complete if it
+  // holds every move from its state (not true for restored frames), only
+  // then does exhausting it prove the state has no solution.
+  struct frame {
+    game_state board ;
+    move moves[MAX_MOVES] ;
+    int nmoves, next ;
+    bool complete ;
+  } ;
+  // Generate moves for the state at the top of the stack, returns false
+  // if the state is a leaf
+  bool expand() ;
+
+  // Look up s in the endgame database, returns true if that settles
+  // whether s can be solved (a solution is stored in tail)
+  bool endgameKnows(const game_state &s) ;
+
+  dead_table *memo ;
+  const endgame_db *endgame ;
+  const move_order *order ;
+  int layout ;                // layout of the root in the endgame database
+  move tail[MAX_DEPTH] ;      // moves from the endgame database that
+  int ntail ;                 // finish the solution
+  game_state start ;
+  frame stack[MAX_DEPTH+1] ;
+  int depth ;
+  bool done, found ;
+  long expanded ;
+} ;
+
+// The number of distinct move sequences that solve a game state, and the
+// set of cells (bit j+i*JDIM) where the last peg can end up.  The count
+// can exceed 64 bits for boards with many pegs.
+struct solution_count {
+  unsigned __int128 paths ;
+  unsigned int finals ;
+  solution_count() : paths(0), finals(0) {}
+} ;
+
+// Count all solutions of a game state.  The game tree is a DAG (many
+// move orders reach the same position), so the count for every position
+// is memoized by its packed board.  The memo is kept between puzzles,
+// since puzzles in a batch share many positions.
+class solution_counter {
+public:
+  solution_counter(size_t limit = 1<<22) : memo_limit(limit) {}
+  solution_count count(const game_state &s) ;
+  // number of positions in the memo
+  size_t size() const { return memo.size() ; }
+private:
+  solution_count countState(const game_state &s) ;
+  std::unordered_map<unsigned long long,solution_count> memo ;
+  size_t memo_limit ;
+} ;
+
+// Search for a solution to the game, if a solution is found, the
+// vector of moves that obtains this is stored in solution
+extern bool depthFirstSearch(const game_state &s, int &size, move solution[]) ;
+
+#endif
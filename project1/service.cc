@@ -0,0 +1,281 @@
+// C++ standard I/O and library includes
+#include <algorithm>
+#include <string>
+#include <sstream>
+#include <vector>
+
+using std::string ;
+using std::vector ;
+using std::ostringstream ;
+
+// Standard Includes for C and OS calls
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "service.h"
+
+// Bytes of results a client may leave unread before it is dropped
+const size_t MAX_UNSENT = 1<<20 ;
+// Milliseconds the results still unsent at the end may wait for the client
+const int DRAIN_WAIT = 1000 ;
+
+puzzle_service::~puzzle_service() {
+  // Give the client a moment to read the last results
+  while(!unsent.empty()) {
+    pollfd fd ;
+    fd.fd = out ;
+    fd.events = POLLOUT ;
+    fd.revents = 0 ;
+    if(poll(&fd,1,DRAIN_WAIT) <= 0)
+      break ;
+    Flush() ;
+  }
+  Disconnect() ;
+  if(listener >= 0) {
+    close(listener) ;
+    unlink(path.c_str()) ;
+  }
+}
+
+bool puzzle_service::Open(const char *endpoint) {
+  // A client that goes away must not kill the server
+  signal(SIGPIPE,SIG_IGN) ;
+  if(strcmp(endpoint,"-") == 0) {
+    in = 0 ;
+    out = 1 ;
+    return true ;
+  }
+
+  sockaddr_un address ;
+  if(strlen(endpoint) >= sizeof(address.sun_path))
+    return false ;
+  memset(&address,0,sizeof(address)) ;
+  address.sun_family = AF_UNIX ;
+  strcpy(address.sun_path,endpoint) ;
+
+  // Remove the socket of an earlier run, but nothing else
+  struct stat st ;
+  if(stat(endpoint,&st) == 0 && S_ISSOCK(st.st_mode))
+    unlink(endpoint) ;
+
+  listener = socket(AF_UNIX,SOCK_STREAM,0) ;
+  if(listener < 0)
+    return false ;
+  if(bind(listener,(sockaddr *)&address,sizeof(address)) != 0 ||
+     listen(listener,4) != 0) {
+    close(listener) ;
+    listener = -1 ;
+    return false ;
+  }
+  fcntl(listener,F_SETFL,O_NONBLOCK) ;
+  path = endpoint ;
+  return true ;
+}
+
+void puzzle_service::Poll(double timeout) {
+  // Wait for boards, and for room to send the results not yet sent
+  pollfd fds[2] ;
+  int count = 0, input = -1, output = -1 ;
+  if(!quit && !input_closed) {
+    fds[count].fd = in >= 0 ? in : listener ;
+    fds[count].events = POLLIN ;
+    fds[count].revents = 0 ;
+    input = count++ ;
+  }
+  if(!unsent.empty()) {
+    fds[count].fd = out ;
+    fds[count].events = POLLOUT ;
+    fds[count].revents = 0 ;
+    output = count++ ;
+  }
+  if(count == 0 && quit)
+    return ;
+  int ms = boards.empty() ? int(timeout*1000) : 0 ;
+  if(poll(fds,count,ms) <= 0)
+    return ;
+  if(output >= 0 && fds[output].revents != 0) {
+    Flush() ;
+    closeIfAnswered() ;
+  }
+  if(input < 0 || fds[input].revents == 0)
+    return ;
+  if(in < 0) {
+    Accept() ;
+    return ;
+  }
+
+  char buf[4096] ;
+  ssize_t n = read(in,buf,sizeof(buf)) ;
+  if(n < 0 && (errno == EINTR || errno == EAGAIN))
+    return ;
+  if(n < 0 && listener >= 0) {
+    Disconnect() ;
+    return ;
+  }
+  if(n <= 0) {
+    // The end of standard input ends the service.  A socket client
+    // that is done sending still gets the results of its boards, then
+    // the connection makes way for the next one.
+    pending += '\n' ;
+    Parse() ;
+    if(listener < 0)
+      quit = true ;
+    else {
+      input_closed = true ;
+      closeIfAnswered() ;
+    }
+    return ;
+  }
+  pending.append(buf,n) ;
+  Parse() ;
+}
+
+void puzzle_service::Accept() {
+  int fd = accept(listener,0,0) ;
+  if(fd < 0)
+    return ;
+  // Results are queued rather than block the server when the client
+  // is slow to read them
+  fcntl(fd,F_SETFL,O_NONBLOCK) ;
+  in = out = fd ;
+  input_closed = false ;
+  line_id = 0 ;
+  connection_first = handed ;
+  task_ids.clear() ;
+  replied = 0 ;
+}
+
+void puzzle_service::closeIfAnswered() {
+  if(in >= 0 && input_closed && boards.empty() && replied == int(task_ids.size()) &&
+     unsent.empty())
+    Disconnect() ;
+}
+
+void puzzle_service::Disconnect() {
+  if(in < 0 || listener < 0)
+    return ;
+  close(in) ;
+  in = out = -1 ;
+  input_closed = false ;
+  pending.clear() ;
+  unsent.clear() ;
+  boards.clear() ;
+  ids.clear() ;
+}
+
+void puzzle_service::Drop() {
+  if(listener < 0) {
+    quit = true ;
+    unsent.clear() ;
+    boards.clear() ;
+    ids.clear() ;
+  } else
+    Disconnect() ;
+}
+
+void puzzle_service::Parse() {
+  size_t start = 0, end ;
+  while(!quit && in >= 0 && (end = pending.find('\n',start)) != string::npos) {
+    string line = pending.substr(start,end-start) ;
+    start = end+1 ;
+    size_t first = line.find_first_not_of(" \t\r") ;
+    if(first == string::npos)
+      continue ;
+    line = line.substr(first,line.find_last_not_of(" \t\r")+1-first) ;
+    if(line == "quit") {
+      quit = true ;
+      break ;
+    }
+    int id = line_id++ ;
+    bool valid = line.size() <= IDIM*JDIM ;
+    vector<unsigned char> board(IDIM*JDIM,'2') ;
+    for(size_t c=0;valid && c<line.size();++c) {
+      valid = line[c] >= '0' && line[c] <= '2' ;
+      board[c] = line[c] ;
+    }
+    if(!valid) {
+      ostringstream reply ;
+      reply << id << " invalid\n" ;
+      Send(reply.str()) ;
+      continue ;
+    }
+    boards.push_back(board) ;
+    ids.push_back(id) ;
+  }
+  pending.erase(0,std::min(start,pending.size())) ;
+}
+
+void puzzle_service::Next(unsigned char board[IDIM*JDIM]) {
+  memcpy(board,&boards.front()[0],IDIM*JDIM) ;
+  task_ids.push_back(ids.front()) ;
+  boards.pop_front() ;
+  ids.pop_front() ;
+  ++handed ;
+}
+
+void puzzle_service::Reply(const solve_result &result) {
+  int k = result.task-connection_first ;
+  if(k < 0 || k >= int(task_ids.size()))
+    return ;
+  ++replied ;
+  ostringstream reply ;
+  reply << task_ids[k] ;
+  if(result.status == solve_result::SOLUTION) {
+    reply << " solution " << result.nodes ;
+    for(int m=0;m<result.size;++m)
+      reply << " " << result.solution[m].i << "," << result.solution[m].j
+            << "," << result.solution[m].dir ;
+  }
+  else if(result.status == solve_result::TIMED_OUT)
+    reply << " timed-out " << result.nodes ;
+  else
+    reply << " no-solution " << result.nodes ;
+  reply << "\n" ;
+  Send(reply.str()) ;
+  closeIfAnswered() ;
+}
+
+void puzzle_service::Send(const string &line) {
+  if(out < 0)
+    return ;
+  unsent += line ;
+  Flush() ;
+  // A client that has stopped reading must not hold up the server
+  if(unsent.size() > MAX_UNSENT)
+    Drop() ;
+}
+
+void puzzle_service::Flush() {
+  while(!unsent.empty()) {
+    // Standard output may block, so it is written only when poll says
+    // there is room, a pipe's worth at a time
+    if(listener < 0) {
+      pollfd fd ;
+      fd.fd = out ;
+      fd.events = POLLOUT ;
+      fd.revents = 0 ;
+      if(poll(&fd,1,0) <= 0)
+        return ;
+    }
+    size_t size = listener < 0 ? std::min(unsent.size(),size_t(PIPE_BUF)) : unsent.size() ;
+    ssize_t n = write(out,unsent.data(),size) ;
+    if(n < 0 && errno == EINTR)
+      continue ;
+    if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      return ;
+    if(n <= 0) {
+      // Nobody is listening any more
+      Drop() ;
+      return ;
+    }
+    unsent.erase(0,n) ;
+  }
+}
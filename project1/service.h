@@ -0,0 +1,86 @@
+#ifndef SERVICE_H
+#define SERVICE_H
+
+// C++ standard I/O and library includes
+#include <string>
+#include <deque>
+#include <vector>
+
+#include "result.h"
+
+// The boards and results of --service mode.  The server reads boards
+// from standard input ("-") or from connections to a Unix socket it
+// makes at a path, and writes a result line back as each puzzle
+// finishes, so one long run answers many requests with warm workers,
+// memo table and endgame database.  The socket serves one connection
+// at a time, and the next connection is accepted when it closes.  A
+// client may shut down its sending side after its last board and
+// still gets every result before the connection closes.
+//
+// Requests are lines of IDIM*JDIM characters in the text puzzle
+// format ('0' hole, '1' peg, '2' not on the board, missing characters
+// at the end are '2').  Blank lines are skipped and "quit" stops the
+// service once the puzzles already sent are finished, as does the end
+// of standard input.  Boards are numbered from 0 in the order they
+// arrive on a connection, and each gets one line back, in the order
+// the puzzles finish:
+//   id solution nodes i,j,dir ...   the moves of a solution
+//   id no-solution nodes
+//   id timed-out nodes              past --time-limit
+//   id invalid                      not a board
+// Results wait in a queue until the client has room for them, so a
+// slow client never stalls the run, and a client that leaves more than
+// a megabyte of them unread is dropped.
+class puzzle_service {
+public:
+  puzzle_service() : listener(-1), in(-1), out(-1), input_closed(false), quit(false),
+                     line_id(0), handed(0), connection_first(0), replied(0) {}
+  ~puzzle_service() ;
+  // Serve standard input and output ("-") or a Unix socket at path,
+  // returns false if the socket can't be made
+  bool Open(const char *endpoint) ;
+  // Read the boards that have arrived.  When none is waiting, wait up
+  // to timeout seconds for one.
+  void Poll(double timeout) ;
+  // true if a board is waiting to be solved
+  bool ready() const { return !boards.empty() ; }
+  // true once no more boards will arrive
+  bool finished() const { return quit && boards.empty() ; }
+  // Take the next board.  Boards are handed out as tasks 0, 1, ...
+  // over the whole run.
+  void Next(unsigned char board[IDIM*JDIM]) ;
+  // Send the result of a finished task.  Results of tasks from a
+  // connection that has closed are dropped.
+  void Reply(const solve_result &result) ;
+private:
+  void Accept() ;
+  void Disconnect() ;
+  // Close a connection whose client has stopped sending once all its
+  // boards are answered and the results sent
+  void closeIfAnswered() ;
+  // Stop serving a client that has gone away: close its connection, or
+  // end the service on standard input
+  void Drop() ;
+  // Take the complete lines that have arrived
+  void Parse() ;
+  // Queue a line for the client and send what it has room for
+  void Send(const std::string &line) ;
+  void Flush() ;
+
+  std::string path ;                      // Socket path, empty for stdin
+  int listener ;                          // Listening socket
+  int in, out ;                           // Connection (-1 when none)
+  bool input_closed ;                     // The client has stopped sending
+  bool quit ;
+  std::string pending ;                   // Start of a line not yet complete
+  std::string unsent ;                    // Results the client has no room for yet
+  std::deque<std::vector<unsigned char> > boards ;
+  std::deque<int> ids ;                   // Id on the connection of each board
+  int line_id ;                           // Id of the next board to arrive
+  int handed ;                            // Tasks handed out so far
+  int connection_first ;                  // First task of this connection
+  std::vector<int> task_ids ;             // Id of each task of this connection
+  int replied ;                           // Tasks of this connection answered
+} ;
+
+#endif
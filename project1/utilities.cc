@@ -60,13 +60,3 @@ void chopsigs_() {
   alarm(sleep_time) ;
 }
 
-
-// A utility routine for measuring time
-double get_timer() {
-  static double to = 0;
-  double tn,t ;
-  tn = MPI_Wtime() ;
-  t = tn - to ;
-  to = tn ;
-  return t ;
-}
@@ -0,0 +1,958 @@
+#include "collectives.h"
+#include "context.h"
+#include "profile.h"
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include <string.h>
+
+/******************************************************************************
+* Bytes of one block of count elements of type                                *
+******************************************************************************/
+static size_t blockBytes(int count, MPI_Datatype type) {
+    MPI_Aint lower_bound, extent ;
+    MPI_Type_get_extent(type, &lower_bound, &extent) ;
+    return size_t(count)*size_t(extent) ;
+}
+
+/******************************************************************************
+* This function should implement the All to All Broadcast.  The value for each*
+* processor is given by the argument send_value.  The recv_buffer argument is *
+* an array of size p that will store the values that each processor transmits.*
+* See Program 4.7 page 162 of the text.                                       *
+******************************************************************************/
+
+/******************************************************************************
+* One dimension step of the hypercube all to all broadcast for the logical    *
+* processor me (physical or virtual).  Every logical processor keeps its      *
+* blocks at their absolute offsets in recv_buffer, so after step i it holds   *
+* the blocks of the 2^(i+1) processors of its subcube.  Only blocks of        *
+* physical processors carry data, so the ranges are clipped to numprocs and   *
+* each step sends exactly the blocks the partner is missing.                  *
+******************************************************************************/
+struct hypercube_exchange {
+    int dest ;                              // Physical processor of the partner
+    int send_tag, recv_tag ;
+    int send_first, send_count ;            // Blocks sent
+    int recv_first, recv_count ;            // Blocks received
+} ;
+
+// The exchange of step i for me, false if there is nothing to exchange
+static bool hypercubeExchange(int me, int i, int half, int myid, int numprocs, hypercube_exchange &x) {
+
+    int partner = me ^ pow2(i) ;
+
+    // The blocks held by me and by the partner before this step
+    int my_first = me & ~(pow2(i)-1) ;
+    int partner_first = partner & ~(pow2(i)-1) ;
+    int my_count = std::max(0, std::min(my_first+(int)pow2(i), numprocs) - my_first) ;
+    int partner_count = std::max(0, std::min(partner_first+(int)pow2(i), numprocs) - partner_first) ;
+    if (my_count == 0 && partner_count == 0)
+        return false ;
+
+    // A virtual partner is hosted by the processor in the lower half
+    // of the hypercube.  When that is this processor the blocks are
+    // already in place.
+    int dest = partner < numprocs ? partner : partner ^ half ;
+    if (dest == myid)
+        return false ;
+
+    x.dest = dest ;
+    x.send_tag = partner ;
+    x.recv_tag = me ;
+    x.send_first = my_first ;
+    x.send_count = my_count ;
+    x.recv_first = partner_first ;
+    x.recv_count = partner_count ;
+    return true ;
+}
+
+static void AllToAllStep(int me, int i, char *recv_buffer, int count, MPI_Datatype type, size_t block,
+                         int half, int myid, int numprocs, MPI_Comm comm) {
+
+    hypercube_exchange x ;
+    if (!hypercubeExchange(me, i, half, myid, numprocs, x))
+        return ;
+
+    MPI_Status status ;
+    MPI_Sendrecv(recv_buffer+x.send_first*block, x.send_count*count, type, x.dest, x.send_tag,
+                 recv_buffer+x.recv_first*block, x.recv_count*count, type, x.dest, x.recv_tag, comm, &status) ;
+}
+
+void AllToAllHypercube(const void *send_value, void *recv_buffer, int count, MPI_Datatype type, MPI_Comm comm){
+
+    PROFILE_SCOPE("AllToAllHypercube") ;
+
+    // MPI_Allgather(send_value,count,type,recv_buffer,count,type,comm) ;
+
+    int numprocs, myid ;
+    MPI_Comm_size(comm, &numprocs) ;
+    MPI_Comm_rank(comm, &myid) ;
+    size_t block = blockBytes(count, type) ;
+    char *recv = (char *)recv_buffer ;
+
+    int dimension = log2(numprocs) ;        // Hypercube dimension
+    int half = pow2(dimension-1) ;          // Processors in the lower half of the hypercube
+
+    /*
+        When the number of processors is not a power of 2 the
+        hypercube is completed with virtual processors.  Let us
+        use the example of 3 procs.  The next power of 2 is 4,
+        and virtual processor 3 is hosted by processor 1 in the
+        lower half of the dimension divide.
+
+            2 --------- 3
+            |           |
+            |           |
+        ---------------------
+            |           |
+            |           |
+            0 ---------- 1
+    */
+    int virtual_id = myid ^ half ;          // Virtual id hosted by this processor
+    bool has_virtual_id = numprocs > 1 && myid < half && virtual_id >= numprocs ;
+
+    // Start with this processor's own block in place
+    memcpy(recv+myid*block, send_value, block) ;
+
+    // Perform All-To-All Hypercube Algorithm, the hosted virtual
+    // processor takes its step after the physical one
+    for (int i=0; i<dimension; ++i) {
+        AllToAllStep(myid, i, recv, count, type, block, half, myid, numprocs, comm) ;
+        if (has_virtual_id)
+            AllToAllStep(virtual_id, i, recv, count, type, block, half, myid, numprocs, comm) ;
+    }
+}
+
+/******************************************************************************
+* All to All Broadcast on a ring.  In step k each processor passes the block  *
+* it received in the step before to its right neighbour, so after p-1 steps   *
+* every block has gone round the ring.  Each step moves a single block        *
+* between neighbours, which suits large messages.                             *
+******************************************************************************/
+
+void AllToAllRing(const void *send_value, void *recv_buffer, int count, MPI_Datatype type, MPI_Comm comm) {
+
+    PROFILE_SCOPE("AllToAllRing") ;
+
+    MPI_Status status ;
+    int numprocs, myid ;
+    MPI_Comm_size(comm, &numprocs) ;
+    MPI_Comm_rank(comm, &myid) ;
+    size_t block = blockBytes(count, type) ;
+    char *recv = (char *)recv_buffer ;
+    int right = (myid+1)%numprocs ;
+    int left = (myid-1+numprocs)%numprocs ;
+
+    memcpy(recv+myid*block, send_value, block) ;
+
+    for (int k=0; k<numprocs-1; ++k) {
+        int send_block = (myid-k+numprocs)%numprocs ;
+        int recv_block = (myid-k-1+numprocs)%numprocs ;
+        MPI_Sendrecv(recv+send_block*block, count, type, right, 0,
+                     recv+recv_block*block, count, type, left, 0, comm, &status) ;
+    }
+}
+
+/******************************************************************************
+* The ring with each block split into segments of pipeline_segment bytes.     *
+* A segment is passed on as soon as it has arrived, rather than when its      *
+* whole block has, so the receive of the next segment from the left overlaps  *
+* the send of this one to the right.  Every receive is posted at the start,   *
+* straight into the block's place in recv_buffer, and the sends follow in     *
+* ring order, each waiting only for the segment it forwards.                  *
+******************************************************************************/
+
+size_t pipeline_segment = 32768 ;
+
+void AllToAllPipelined(const void *send_value, void *recv_buffer, int count, MPI_Datatype type, MPI_Comm comm) {
+
+    PROFILE_SCOPE("AllToAllPipelined") ;
+
+    int numprocs, myid ;
+    MPI_Comm_size(comm, &numprocs) ;
+    MPI_Comm_rank(comm, &myid) ;
+    size_t extent = blockBytes(1, type) ;
+    size_t block = extent*count ;
+    char *recv = (char *)recv_buffer ;
+    int right = (myid+1)%numprocs ;
+    int left = (myid-1+numprocs)%numprocs ;
+
+    memcpy(recv+myid*block, send_value, block) ;
+    if (numprocs == 1 || count == 0)
+        return ;
+
+    // Elements per segment and segments per block
+    int segment = (int)std::min<size_t>(count, std::max<size_t>(1, pipeline_segment/extent)) ;
+    int segments = (count+segment-1)/segment ;
+
+    // Message n is segment n%segments of the block of step n/segments
+    int messages = (numprocs-1)*segments ;
+    collective_context &context = collective_context::Get(comm) ;
+    MPI_Request *receives = context.scratch<MPI_Request>(collective_context::SCRATCH_WORK, 2*messages) ;
+    MPI_Request *sends = receives + messages ;
+
+    for (int n=0; n<messages; ++n) {
+        int recv_block = (myid-n/segments-1+numprocs)%numprocs ;
+        int first = (n%segments)*segment ;
+        MPI_Irecv(recv+recv_block*block+first*extent, std::min(segment, count-first), type, left, 0,
+                  comm, &receives[n]) ;
+    }
+
+    for (int n=0; n<messages; ++n) {
+        // Past the first step the segment is the one received a step ago
+        if (n >= segments)
+            MPI_Wait(&receives[n-segments], MPI_STATUS_IGNORE) ;
+        int send_block = (myid-n/segments+numprocs)%numprocs ;
+        int first = (n%segments)*segment ;
+        MPI_Isend(recv+send_block*block+first*extent, std::min(segment, count-first), type, right, 0,
+                  comm, &sends[n]) ;
+    }
+
+    MPI_Waitall(messages, receives, MPI_STATUSES_IGNORE) ;
+    MPI_Waitall(messages, sends, MPI_STATUSES_IGNORE) ;
+}
+
+/******************************************************************************
+* All to All Broadcast with Bruck's algorithm, for any number of processors   *
+* without virtual processors.  Block j of the working buffer holds the block  *
+* of processor (myid+j)%p.  Step k sends the first min(k,p-k) blocks to       *
+* processor myid-k and receives the blocks that follow them from myid+k, so   *
+* the blocks held double each step and ceil(log2(p)) steps are taken.         *
+******************************************************************************/
+
+void AllToAllBruck(const void *send_value, void *recv_buffer, int count, MPI_Datatype type, MPI_Comm comm) {
+
+    PROFILE_SCOPE("AllToAllBruck") ;
+
+    MPI_Status status ;
+    int numprocs, myid ;
+    MPI_Comm_size(comm, &numprocs) ;
+    MPI_Comm_rank(comm, &myid) ;
+    size_t block = blockBytes(count, type) ;
+    char *recv = (char *)recv_buffer ;
+
+    collective_context &context = collective_context::Get(comm) ;
+    char *work_buffer = context.scratch<char>(collective_context::SCRATCH_WORK, block*numprocs) ;
+
+    memcpy(work_buffer, send_value, block) ;
+
+    for (int step=1; step<numprocs; step*=2) {
+        int dest = (myid-step+numprocs)%numprocs ;
+        int source = (myid+step)%numprocs ;
+        int blocks = std::min(step, numprocs-step) ;
+        MPI_Sendrecv(work_buffer, blocks*count, type, dest, 0,
+                     work_buffer+step*block, blocks*count, type, source, 0, comm, &status) ;
+    }
+
+    // Rotate the blocks into the place of the processor they came from
+    for (int j=0; j<numprocs; ++j)
+        memcpy(recv+((myid+j)%numprocs)*block, work_buffer+j*block, block) ;
+}
+
+/******************************************************************************
+* All to All Broadcast in two levels.  The processors of each node gather     *
+* their blocks in memory shared by the node, only the first processor of      *
+* each node (the leader) takes part in the hypercube between nodes, with the  *
+* blocks of a whole node as one block, and every processor then reads the     *
+* blocks of all nodes from the shared memory.  Messages between nodes drop    *
+* by the number of processors per node.  Nodes with fewer processors than the *
+* largest are padded to its size.                                             *
+******************************************************************************/
+
+void AllToAllHierarchical(const void *send_value, void *recv_buffer, int count, MPI_Datatype type, MPI_Comm comm) {
+
+    PROFILE_SCOPE("AllToAllHierarchical") ;
+
+    collective_context &context = collective_context::Get(comm) ;
+    const collective_context::node_layout &layout = context.layout(comm) ;
+    size_t block = blockBytes(count, type) ;
+    size_t node_block = block*layout.max_node_size ;
+    char *recv = (char *)recv_buffer ;
+
+    // The blocks of this node, then the blocks of every node
+    char *node_buffer = context.shared(comm, node_block*(layout.node_count+1)) ;
+    char *all_buffer = node_buffer + node_block ;
+
+    memcpy(node_buffer+layout.node_rank*block, send_value, block) ;
+    context.nodeSync() ;
+
+    if (layout.leaders != MPI_COMM_NULL) {
+        MPI_Datatype node_type ;
+        MPI_Type_contiguous(count*layout.max_node_size, type, &node_type) ;
+        MPI_Type_commit(&node_type) ;
+        AllToAllHypercube(node_buffer, all_buffer, 1, node_type, layout.leaders) ;
+        MPI_Type_free(&node_type) ;
+    }
+    context.nodeSync() ;
+
+    // Put the blocks in the order of the communicator.  The next call
+    // uses the other shared buffer, and the one after waits at its
+    // first nodeSync for every processor to finish here, so no sync is
+    // needed.
+    for (size_t k=0; k<layout.origin.size(); ++k) {
+        if (layout.origin[k] >= 0)
+            memcpy(recv+layout.origin[k]*block, all_buffer+k*block, block) ;
+    }
+}
+
+/******************************************************************************
+* This function should implement the All to All Personalized Broadcast.       *
+* A value destined for each processor is given by the argument array          *
+* send_buffer of size p.  The recv_buffer argument is an array of size p      *
+* that will store the values that each processor transmits.                   *
+* See pages 175-179 in the text.                                              *
+******************************************************************************/
+
+/******************************************************************************
+* The mesh exchanges the same positions in both directions: in step i each    *
+* processor sends its blocks at the positions whose bit i differs from its    *
+* own id and receives the partner's blocks into those positions.  Position j  *
+* is therefore exchanged once for every bit where j and myid differ, and the  *
+* block at myid never moves.                                                  *
+*                                                                             *
+* Rather than exchanging whole buffers and shuffling half back, every block   *
+* alternates between recv_buffer and a spare buffer: it is sent from where it *
+* is and received into the other one, starting in send_buffer.  The first     *
+* buffer is chosen so that the last exchange of each position lands in        *
+* recv_buffer, so nothing is copied apart from the processor's own block.     *
+* The blocks of a step are scattered over the three buffers, so each step is  *
+* described by hindexed datatypes of absolute addresses, sent from MPI_BOTTOM.*
+******************************************************************************/
+
+static int popcount(unsigned int bits) {
+    int n = 0 ;
+    for (; bits != 0; bits &= bits-1)
+        ++n ;
+    return n ;
+}
+
+// Build the datatypes of the blocks sent and received by step i
+static void meshStepTypes(const char *send_buffer, char *recv_buffer, char *spare_buffer, int i,
+                          int myid, int numprocs, int count, MPI_Datatype type, size_t block,
+                          MPI_Datatype &send_type, MPI_Datatype &recv_type) {
+
+    int blocks = numprocs/2 ;
+    int *lengths = new int[blocks] ;
+    MPI_Aint *send_places = new MPI_Aint[blocks] ;
+    MPI_Aint *recv_places = new MPI_Aint[blocks] ;
+
+    int b = 0 ;
+    for (int j=0; j<numprocs; ++j) {
+        unsigned int differ = j ^ myid ;
+        if (!(differ & pow2(i)))
+            continue ;
+        // Exchanges of position j before this one, and remaining with this one
+        int done = popcount(differ & (pow2(i)-1)) ;
+        int remaining = popcount(differ) - done ;
+        const char *from ;
+        if (done == 0)
+            from = send_buffer + j*block ;
+        else
+            from = ((remaining+1) & 1 ? recv_buffer : spare_buffer) + j*block ;
+        char *to = (remaining & 1 ? recv_buffer : spare_buffer) + j*block ;
+
+        lengths[b] = count ;
+        MPI_Get_address(from, &send_places[b]) ;
+        MPI_Get_address(to, &recv_places[b]) ;
+        ++b ;
+    }
+
+    MPI_Type_create_hindexed(blocks, lengths, send_places, type, &send_type) ;
+    MPI_Type_create_hindexed(blocks, lengths, recv_places, type, &recv_type) ;
+    MPI_Type_commit(&send_type) ;
+    MPI_Type_commit(&recv_type) ;
+
+    delete[] lengths ;
+    delete[] send_places ;
+    delete[] recv_places ;
+}
+
+void AllToAllPersonalizedMesh(const void *send_buffer, void *recv_buffer, int count, MPI_Datatype type, MPI_Comm comm) {
+
+    PROFILE_SCOPE("AllToAllPersonalizedMesh") ;
+
+    // MPI_Alltoall(send_buffer,count,type,recv_buffer,count,type,comm) ;
+
+    // Both flags CANNOT be set true at the same time.
+    bool run_e_cube_alg = false ;
+    bool run_mesh_alg = true ;
+
+    // MPI Primitives
+    MPI_Status status ;
+    int TAG_SEND = 0 ;
+    int TAG_RECV = 0 ;
+
+    int numprocs, myid ;
+    MPI_Comm_size(comm, &numprocs) ;
+    MPI_Comm_rank(comm, &myid) ;
+
+    int partner = 0 ;
+    int i = 0 ;
+    int dimension = numprocs > 1 ? log2(numprocs) : 0 ;  // log2 rounds 1 up to 1
+    size_t block = blockBytes(count, type) ;
+    size_t total = block*numprocs ;         // Bytes held by each processor
+
+    // The buffers come from the communicator's context and are
+    // reused between calls.
+    collective_context &context = collective_context::Get(comm) ;
+
+    // Perform E-Cube Routing Algorithm
+    if (run_e_cube_alg) {
+
+        char *work_buffer = context.scratch<char>(collective_context::SCRATCH_WORK, total) ;
+        char *temp_buffer = context.scratch<char>(collective_context::SCRATCH_RECV, total) ;
+        memcpy(work_buffer, send_buffer, total) ;
+
+        for (i=1; i < numprocs; ++i) {
+
+            partner = myid ^ i;
+
+            MPI_Sendrecv(work_buffer, count*numprocs, type, partner, TAG_SEND,
+                temp_buffer, count*numprocs, type, partner, TAG_RECV, comm, &status);
+
+            memcpy(work_buffer+partner*block, temp_buffer+myid*block, block) ;
+        }
+
+        memcpy(recv_buffer, work_buffer, total) ;
+    }
+
+    // Perform Mesh Algorithm
+    if (run_mesh_alg) {
+
+        char *spare_buffer = context.scratch<char>(collective_context::SCRATCH_WORK, total) ;
+        char *recv = (char *)recv_buffer ;
+
+        // This processor's own block stays in place
+        memcpy(recv+myid*block, (const char *)send_buffer+myid*block, block) ;
+
+        // This works similiarly to the setup of the
+        // traditional hypercube algorithm.
+        for (i=0; i<dimension; ++i) {
+
+            // Establish partner id
+            partner = myid ^ pow2(i) ;
+
+            // Exchange only the half of the blocks bound for
+            // the partner's side, straight into place
+            MPI_Datatype send_type, recv_type ;
+            meshStepTypes((const char *)send_buffer, recv, spare_buffer, i, myid, numprocs,
+                          count, type, block, send_type, recv_type) ;
+            MPI_Sendrecv(MPI_BOTTOM, 1, send_type, partner, TAG_SEND,
+                MPI_BOTTOM, 1, recv_type, partner, TAG_RECV, comm, &status) ;
+            MPI_Type_free(&send_type) ;
+            MPI_Type_free(&recv_type) ;
+        }
+    }
+}
+
+/******************************************************************************
+* All to All Personalized Broadcast with Bruck's algorithm, for any number of *
+* processors.  It takes ceil(log2(p)) steps, which suits small messages.      *
+* After rotating the blocks so that block j is bound for processor            *
+* (myid+j)%p, step k sends every block whose index has bit k set to           *
+* processor myid+2^k and receives the same block positions from               *
+* myid-2^k.  A final rotation puts the block from each source in place.       *
+******************************************************************************/
+
+// Pack the blocks of work whose index has the bit step set, returns the count
+static int packBruck(char *pack_buffer, const char *work_buffer, int step, int numprocs, size_t block) {
+    int blocks = 0 ;
+    for (int j=step; j<numprocs; ++j) {
+        if (j & step) {
+            memcpy(pack_buffer+blocks*block, work_buffer+j*block, block) ;
+            ++blocks ;
+        }
+    }
+    return blocks ;
+}
+
+// Unpack the blocks received into the positions they were packed from
+static void unpackBruck(char *work_buffer, const char *temp_buffer, int step, int numprocs, size_t block) {
+    int blocks = 0 ;
+    for (int j=step; j<numprocs; ++j) {
+        if (j & step) {
+            memcpy(work_buffer+j*block, temp_buffer+blocks*block, block) ;
+            ++blocks ;
+        }
+    }
+}
+
+void AllToAllPersonalizedBruck(const void *send_buffer, void *recv_buffer, int count, MPI_Datatype type, MPI_Comm comm) {
+
+    PROFILE_SCOPE("AllToAllPersonalizedBruck") ;
+
+    MPI_Status status ;
+    int numprocs, myid ;
+    MPI_Comm_size(comm, &numprocs) ;
+    MPI_Comm_rank(comm, &myid) ;
+    size_t block = blockBytes(count, type) ;
+    size_t total = block*numprocs ;
+    const char *send = (const char *)send_buffer ;
+    char *recv = (char *)recv_buffer ;
+
+    collective_context &context = collective_context::Get(comm) ;
+    char *work_buffer = context.scratch<char>(collective_context::SCRATCH_WORK, total) ;
+    char *pack_buffer = context.scratch<char>(collective_context::SCRATCH_PACK, total) ;
+    char *temp_buffer = context.scratch<char>(collective_context::SCRATCH_RECV, total) ;
+
+    // Rotate the blocks so that block j is bound for processor myid+j
+    for (int j=0; j<numprocs; ++j)
+        memcpy(work_buffer+j*block, send+((myid+j)%numprocs)*block, block) ;
+
+    for (int step=1; step<numprocs; step*=2) {
+        int dest = (myid+step)%numprocs ;
+        int source = (myid-step+numprocs)%numprocs ;
+
+        // Pack the blocks with this bit set, send them on and
+        // unpack the ones received into the same positions
+        int blocks = packBruck(pack_buffer, work_buffer, step, numprocs, block) ;
+        MPI_Sendrecv(pack_buffer, blocks*count, type, dest, 0,
+                     temp_buffer, blocks*count, type, source, 0, comm, &status) ;
+        unpackBruck(work_buffer, temp_buffer, step, numprocs, block) ;
+    }
+
+    // Block j now came from processor myid-j
+    for (int j=0; j<numprocs; ++j)
+        memcpy(recv+((myid-j+numprocs)%numprocs)*block, work_buffer+j*block, block) ;
+}
+
+/******************************************************************************
+* All to All Personalized Broadcast by pairwise exchange, for any number of   *
+* processors.  In step k each processor sends its block for myid+k directly  *
+* to it and receives the block from myid-k, so every block travels once,      *
+* which suits large messages.                                                 *
+******************************************************************************/
+
+void AllToAllPersonalizedPairwise(const void *send_buffer, void *recv_buffer, int count, MPI_Datatype type, MPI_Comm comm) {
+
+    PROFILE_SCOPE("AllToAllPersonalizedPairwise") ;
+
+    MPI_Status status ;
+    int numprocs, myid ;
+    MPI_Comm_size(comm, &numprocs) ;
+    MPI_Comm_rank(comm, &myid) ;
+    size_t block = blockBytes(count, type) ;
+    const char *send = (const char *)send_buffer ;
+    char *recv = (char *)recv_buffer ;
+
+    memcpy(recv+myid*block, send+myid*block, block) ;
+
+    for (int step=1; step<numprocs; ++step) {
+        int dest = (myid+step)%numprocs ;
+        int source = (myid-step+numprocs)%numprocs ;
+        MPI_Sendrecv(send+dest*block, count, type, dest, 0,
+                     recv+source*block, count, type, source, 0, comm, &status) ;
+    }
+}
+
+/******************************************************************************
+* Selection of the algorithm used by AllToAll and AllToAllPersonalized        *
+******************************************************************************/
+
+const algorithm_variant alltoall_variants[] = {
+    {"hypercube", AllToAllHypercube, true},
+    {"ring", AllToAllRing, true},
+    {"pipelined", AllToAllPipelined, true},
+    {"bruck", AllToAllBruck, true},
+    {"hierarchical", AllToAllHierarchical, true}
+} ;
+const int alltoall_count = sizeof(alltoall_variants)/sizeof(alltoall_variants[0]) ;
+
+const algorithm_variant personalized_variants[] = {
+    {"mesh", AllToAllPersonalizedMesh, false},
+    {"bruck", AllToAllPersonalizedBruck, true},
+    {"pairwise", AllToAllPersonalizedPairwise, true}
+} ;
+const int personalized_count = sizeof(personalized_variants)/sizeof(personalized_variants[0]) ;
+
+tuning_table tuning ;
+
+collective_algorithm findVariant(const algorithm_variant variants[], int count, int procs, const char *name) {
+    if (name == 0)
+        return 0 ;
+    for (int k=0; k<count; ++k)
+        if (strcmp(variants[k].name, name) == 0)
+            return (variants[k].any_procs || powerOf2(procs)) ? variants[k].algorithm : 0 ;
+    return 0 ;
+}
+
+void AllToAll(const void *send_value, void *recv_buffer, int count, MPI_Datatype type, MPI_Comm comm) {
+    PROFILE_SCOPE("AllToAll") ;
+    int procs ;
+    MPI_Comm_size(comm, &procs) ;
+    collective_algorithm algorithm = 0 ;
+    if (tuning.processors() == procs)
+        algorithm = findVariant(alltoall_variants, alltoall_count, procs,
+                                tuning.Select(tuning_table::ALLTOALL, blockBytes(count, type))) ;
+    if (algorithm == 0)
+        algorithm = AllToAllHypercube ;
+    algorithm(send_value, recv_buffer, count, type, comm) ;
+}
+
+void AllToAllPersonalized(const void *send_buffer, void *recv_buffer, int count, MPI_Datatype type, MPI_Comm comm) {
+    PROFILE_SCOPE("AllToAllPersonalized") ;
+    int procs ;
+    MPI_Comm_size(comm, &procs) ;
+    size_t bytes = blockBytes(count, type) ;
+    collective_algorithm algorithm = 0 ;
+    if (tuning.processors() == procs)
+        algorithm = findVariant(personalized_variants, personalized_count, procs,
+                                tuning.Select(tuning_table::PERSONALIZED, bytes)) ;
+    if (algorithm == 0) {
+        // Without a table use the mesh on a hypercube, otherwise
+        // Bruck for small messages and pairwise exchange for large
+        if (powerOf2(procs))
+            algorithm = AllToAllPersonalizedMesh ;
+        else if (bytes <= 256)
+            algorithm = AllToAllPersonalizedBruck ;
+        else
+            algorithm = AllToAllPersonalizedPairwise ;
+    }
+    algorithm(send_buffer, recv_buffer, count, type, comm) ;
+}
+
+void AllToAll(int send_value[], int recv_buffer[], int size, MPI_Comm comm) {
+    AllToAll(send_value, recv_buffer, size, MPI_INT, comm) ;
+}
+
+void AllToAllPersonalized(int send_buffer[], int recv_buffer[], int size, MPI_Comm comm) {
+    AllToAllPersonalized(send_buffer, recv_buffer, size, MPI_INT, comm) ;
+}
+
+/******************************************************************************
+* Variable count All to All Personalized Broadcast                            *
+******************************************************************************/
+
+void AllToAllCounts(const int send_counts[], int recv_counts[], MPI_Comm comm) {
+    PROFILE_SCOPE("AllToAllCounts") ;
+    AllToAllPersonalized(send_counts, recv_counts, 1, MPI_INT, comm) ;
+}
+
+/******************************************************************************
+* The mesh schedule of AllToAllPersonalizedMesh with blocks of any size.      *
+* Before step i, position j of processor me holds the block from source       *
+* (j&low)|(me&~low) to destination (me&low)|(j&~low), where low has the bits  *
+* below i.  The positions whose bit i differs from me are sent in order and  *
+* the partner's come back in their place.  The blocks are kept packed in     *
+* position order, so with every processor's counts known the size and       *
+* offset of each block follow.                                               *
+******************************************************************************/
+
+// The schedule, given counts[s*p+d], the count processor s sends to d
+static void personalizedvHypercube(const void *send_buffer, const int send_counts[], const int send_displs[],
+                                   void *recv_buffer, const int recv_counts[], const int recv_displs[],
+                                   MPI_Datatype type, MPI_Comm comm, const std::vector<int> &counts) {
+
+    MPI_Status status ;
+    int numprocs, myid ;
+    MPI_Comm_size(comm, &numprocs) ;
+    MPI_Comm_rank(comm, &myid) ;
+    int dimension = numprocs > 1 ? log2(numprocs) : 0 ;  // log2 rounds 1 up to 1
+    size_t extent = blockBytes(1, type) ;
+    const char *send = (const char *)send_buffer ;
+    char *recv = (char *)recv_buffer ;
+
+    // The count of each position before each step, and the most
+    // elements held at any step
+    std::vector<int> sizes((dimension+1)*numprocs) ;
+    size_t held = 0 ;
+    for (int i=0; i<=dimension; ++i) {
+        int low = pow2(i)-1 ;
+        size_t total = 0 ;
+        for (int j=0; j<numprocs; ++j) {
+            int source = (j & low) | (myid & ~low) ;
+            int dest = (myid & low) | (j & ~low) ;
+            sizes[i*numprocs+j] = counts[source*numprocs+dest] ;
+            total += sizes[i*numprocs+j] ;
+        }
+        held = std::max(held, total) ;
+    }
+
+    collective_context &context = collective_context::Get(comm) ;
+    char *work_buffer = context.scratch<char>(collective_context::SCRATCH_WORK, held*extent) ;
+    char *pack_buffer = context.scratch<char>(collective_context::SCRATCH_PACK, held*extent) ;
+    char *temp_buffer = context.scratch<char>(collective_context::SCRATCH_RECV, held*extent) ;
+
+    size_t offset = 0 ;
+    for (int j=0; j<numprocs; ++j) {
+        memcpy(work_buffer+offset, send+send_displs[j]*extent, send_counts[j]*extent) ;
+        offset += send_counts[j]*extent ;
+    }
+
+    for (int i=0; i<dimension; ++i) {
+        int partner = myid ^ pow2(i) ;
+        const int *before = &sizes[i*numprocs] ;
+        const int *after = &sizes[(i+1)*numprocs] ;
+
+        // Pack the positions going to the partner
+        int send_count = 0, recv_count = 0 ;
+        offset = 0 ;
+        for (int j=0; j<numprocs; ++j) {
+            if ((j ^ myid) & pow2(i)) {
+                memcpy(pack_buffer+send_count*extent, work_buffer+offset, before[j]*extent) ;
+                send_count += before[j] ;
+                recv_count += after[j] ;
+            }
+            offset += before[j]*extent ;
+        }
+
+        MPI_Sendrecv(pack_buffer, send_count, type, partner, 0,
+                     temp_buffer, recv_count, type, partner, 0, comm, &status) ;
+
+        // Merge the positions kept with the ones received, in order,
+        // building the next working buffer in the pack buffer
+        size_t kept = 0, received = 0, merged = 0 ;
+        for (int j=0; j<numprocs; ++j) {
+            if ((j ^ myid) & pow2(i)) {
+                memcpy(pack_buffer+merged, temp_buffer+received, after[j]*extent) ;
+                received += after[j]*extent ;
+            }
+            else {
+                memcpy(pack_buffer+merged, work_buffer+kept, after[j]*extent) ;
+            }
+            kept += before[j]*extent ;
+            merged += after[j]*extent ;
+        }
+        std::swap(work_buffer, pack_buffer) ;
+    }
+
+    // Position j now holds the block from processor j
+    offset = 0 ;
+    for (int j=0; j<numprocs; ++j) {
+        memcpy(recv+recv_displs[j]*extent, work_buffer+offset, recv_counts[j]*extent) ;
+        offset += recv_counts[j]*extent ;
+    }
+}
+
+void AllToAllPersonalizedvHypercube(const void *send_buffer, const int send_counts[], const int send_displs[],
+                                    void *recv_buffer, const int recv_counts[], const int recv_displs[],
+                                    MPI_Datatype type, MPI_Comm comm) {
+    PROFILE_SCOPE("AllToAllPersonalizedvHypercube") ;
+    int numprocs ;
+    MPI_Comm_size(comm, &numprocs) ;
+    std::vector<int> counts(numprocs*numprocs) ;
+    AllToAll(send_counts, &counts[0], numprocs, MPI_INT, comm) ;
+    personalizedvHypercube(send_buffer, send_counts, send_displs, recv_buffer, recv_counts, recv_displs,
+                           type, comm, counts) ;
+}
+
+void AllToAllPersonalizedvPairwise(const void *send_buffer, const int send_counts[], const int send_displs[],
+                                   void *recv_buffer, const int recv_counts[], const int recv_displs[],
+                                   MPI_Datatype type, MPI_Comm comm) {
+
+    PROFILE_SCOPE("AllToAllPersonalizedvPairwise") ;
+
+    MPI_Status status ;
+    int numprocs, myid ;
+    MPI_Comm_size(comm, &numprocs) ;
+    MPI_Comm_rank(comm, &myid) ;
+    size_t extent = blockBytes(1, type) ;
+    const char *send = (const char *)send_buffer ;
+    char *recv = (char *)recv_buffer ;
+
+    memcpy(recv+recv_displs[myid]*extent, send+send_displs[myid]*extent, send_counts[myid]*extent) ;
+
+    for (int step=1; step<numprocs; ++step) {
+        int dest = (myid+step)%numprocs ;
+        int source = (myid-step+numprocs)%numprocs ;
+        MPI_Sendrecv(send+send_displs[dest]*extent, send_counts[dest], type, dest, 0,
+                     recv+recv_displs[source]*extent, recv_counts[source], type, source, 0, comm, &status) ;
+    }
+}
+
+void AllToAllPersonalizedv(const void *send_buffer, const int send_counts[], const int send_displs[],
+                           void *recv_buffer, const int recv_counts[], const int recv_displs[],
+                           MPI_Datatype type, MPI_Comm comm) {
+
+    PROFILE_SCOPE("AllToAllPersonalizedv") ;
+
+    // Every processor must take the same schedule, so decide on the
+    // processor count and the counts the hypercube shares anyway
+    int numprocs ;
+    MPI_Comm_size(comm, &numprocs) ;
+    if (powerOf2(numprocs)) {
+        std::vector<int> counts(numprocs*numprocs) ;
+        AllToAll(send_counts, &counts[0], numprocs, MPI_INT, comm) ;
+        int largest = *std::max_element(counts.begin(), counts.end()) ;
+        if (blockBytes(largest, type) <= 256) {
+            personalizedvHypercube(send_buffer, send_counts, send_displs, recv_buffer, recv_counts, recv_displs,
+                                   type, comm, counts) ;
+            return ;
+        }
+    }
+    AllToAllPersonalizedvPairwise(send_buffer, send_counts, send_displs,
+                                  recv_buffer, recv_counts, recv_displs, type, comm) ;
+}
+
+/******************************************************************************
+* Non-blocking collectives                                                    *
+******************************************************************************/
+
+collective_request::collective_request() : kind(DONE) {
+    requests[0] = requests[1] = MPI_REQUEST_NULL ;
+    for (int k=0; k<3; ++k) {
+        buffers[k] = 0 ;
+        sizes[k] = 0 ;
+    }
+}
+
+collective_request::~collective_request() {
+    if (active())
+        Wait() ;
+    for (int k=0; k<3; ++k)
+        delete[] buffers[k] ;
+}
+
+char *collective_request::buffer(int k, size_t bytes) {
+    if (bytes > sizes[k]) {
+        delete[] buffers[k] ;
+        buffers[k] = new char[bytes] ;
+        sizes[k] = bytes ;
+    }
+    return buffers[k] ;
+}
+
+void collective_request::Start(schedule k, const void *send_buffer, void *recv_buffer, int count,
+                               MPI_Datatype type, MPI_Comm comm) {
+    if (active())
+        Wait() ;
+    kind = k ;
+    send = (const char *)send_buffer ;
+    recv = (char *)recv_buffer ;
+    this->count = count ;
+    this->type = type ;
+    MPI_Comm_size(comm, &numprocs) ;
+    MPI_Comm_rank(comm, &myid) ;
+    block = blockBytes(count, type) ;
+    size_t total = block*numprocs ;
+    int dimension = numprocs > 1 ? log2(numprocs) : 0 ;
+
+    // Messages go over a duplicate of comm, with tags of their own among
+    // the collectives in progress.  The hypercube tags its messages with
+    // logical processors, so it takes pow2(dimension) tags.
+    context = &collective_context::Get(comm) ;
+    this->comm = context->requestComm(comm) ;
+    int span = pow2(dimension) ;
+    slot = context->claimSlot(span) ;
+    if (slot < 0) {
+        std::cerr << "too many non-blocking collectives in progress on a communicator" << std::endl ;
+        MPI_Abort(MPI_COMM_WORLD, -1) ;
+    }
+    tag = slot*span ;
+
+    step = 0 ;
+    switch (kind) {
+    case HYPERCUBE:
+        half = pow2(dimension-1) ;
+        virtual_id = myid ^ half ;
+        has_virtual_id = numprocs > 1 && myid < half && virtual_id >= numprocs ;
+        // The hosted virtual processor takes its step after the physical one
+        steps = has_virtual_id ? 2*dimension : dimension ;
+        memcpy(recv+myid*block, send, block) ;
+        break ;
+    case MESH:
+        steps = dimension ;
+        buffer(0, total) ;
+        memcpy(recv+myid*block, send+myid*block, block) ;
+        break ;
+    case BRUCK:
+        steps = dimension ;
+        buffer(0, total) ;
+        buffer(1, total) ;
+        buffer(2, total) ;
+        for (int j=0; j<numprocs; ++j)
+            memcpy(buffers[0]+j*block, send+((myid+j)%numprocs)*block, block) ;
+        break ;
+    case DONE:
+        break ;
+    }
+    startStep() ;
+}
+
+void collective_request::startStep() {
+    for (; step<steps; ++step) {
+        if (kind == HYPERCUBE) {
+            int me = myid, i = step ;
+            if (has_virtual_id) {
+                me = (step & 1) ? virtual_id : myid ;
+                i = step/2 ;
+            }
+            hypercube_exchange x ;
+            if (!hypercubeExchange(me, i, half, myid, numprocs, x))
+                continue ;
+            MPI_Irecv(recv+x.recv_first*block, x.recv_count*count, type, x.dest, tag+x.recv_tag, comm, &requests[0]) ;
+            MPI_Isend(recv+x.send_first*block, x.send_count*count, type, x.dest, tag+x.send_tag, comm, &requests[1]) ;
+        }
+        else if (kind == MESH) {
+            // The datatypes can be freed once the operations using
+            // them are posted
+            int partner = myid ^ pow2(step) ;
+            MPI_Datatype send_type, recv_type ;
+            meshStepTypes(send, recv, buffers[0], step, myid, numprocs, count, type, block,
+                          send_type, recv_type) ;
+            MPI_Irecv(MPI_BOTTOM, 1, recv_type, partner, tag, comm, &requests[0]) ;
+            MPI_Isend(MPI_BOTTOM, 1, send_type, partner, tag, comm, &requests[1]) ;
+            MPI_Type_free(&send_type) ;
+            MPI_Type_free(&recv_type) ;
+        }
+        else {
+            int distance = pow2(step) ;
+            int blocks = packBruck(buffers[2], buffers[0], distance, numprocs, block) ;
+            MPI_Irecv(buffers[1], blocks*count, type, (myid-distance+numprocs)%numprocs, tag, comm, &requests[0]) ;
+            MPI_Isend(buffers[2], blocks*count, type, (myid+distance)%numprocs, tag, comm, &requests[1]) ;
+        }
+        return ;
+    }
+
+    // Every step is done, put the blocks in place
+    if (kind == BRUCK) {
+        for (int j=0; j<numprocs; ++j)
+            memcpy(recv+((myid-j+numprocs)%numprocs)*block, buffers[0]+j*block, block) ;
+    }
+    context->releaseSlot(slot) ;
+    kind = DONE ;
+}
+
+void collective_request::finishStep() {
+    if (kind == BRUCK) {
+        unpackBruck(buffers[0], buffers[1], pow2(step), numprocs, block) ;
+    }
+    ++step ;
+}
+
+bool collective_request::Test() {
+    while (active()) {
+        int flag ;
+        MPI_Testall(2, requests, &flag, MPI_STATUSES_IGNORE) ;
+        if (!flag)
+            return false ;
+        finishStep() ;
+        startStep() ;
+    }
+    return true ;
+}
+
+void collective_request::Wait() {
+    PROFILE_SCOPE("collective_request::Wait") ;
+    while (active()) {
+        MPI_Waitall(2, requests, MPI_STATUSES_IGNORE) ;
+        finishStep() ;
+        startStep() ;
+    }
+}
+
+void IAllToAll(const void *send_value, void *recv_buffer, int count, MPI_Datatype type, MPI_Comm comm,
+               collective_request &request) {
+    PROFILE_SCOPE("IAllToAll") ;
+    request.Start(collective_request::HYPERCUBE, send_value, recv_buffer, count, type, comm) ;
+}
+
+void IAllToAllPersonalized(const void *send_buffer, void *recv_buffer, int count, MPI_Datatype type, MPI_Comm comm,
+                           collective_request &request) {
+    PROFILE_SCOPE("IAllToAllPersonalized") ;
+    int procs ;
+    MPI_Comm_size(comm, &procs) ;
+    request.Start(powerOf2(procs) ? collective_request::MESH : collective_request::BRUCK,
+                  send_buffer, recv_buffer, count, type, comm) ;
+}
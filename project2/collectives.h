@@ -0,0 +1,216 @@
+#ifndef COLLECTIVES_H
+#define COLLECTIVES_H
+
+#include "datatype.h"
+#include "tuning.h"
+#include <mpi.h>
+
+/******************************************************************************
+* All to All Broadcast and All to All Personalized Broadcast.                 *
+*                                                                             *
+* Every routine moves blocks of count elements of an MPI datatype.  In the    *
+* broadcast each processor sends one block and receives p blocks, ordered by  *
+* source.  In the personalized broadcast each processor sends p blocks,       *
+* ordered by destination, and receives p blocks ordered by source.  The       *
+* datatype must be contiguous (its extent equal to its size), as blocks are   *
+* copied between buffers as bytes.                                            *
+*                                                                             *
+* The templates take the datatype from mpi_datatype<T>, and the int versions  *
+* keep the original entry points of the program.                              *
+******************************************************************************/
+
+/******************************************************************************
+* evaluate 2^i                                                                *
+******************************************************************************/
+inline unsigned int pow2(unsigned int i) { return 1 << i ; }
+
+/******************************************************************************
+* evaluate ceil(log2(i))                                                      *
+******************************************************************************/
+inline unsigned int log2(unsigned int i) {
+    i-- ;
+    unsigned int log = 1 ;
+    for(i>>=1;i!=0;i>>=1)
+        log++ ;
+    return log ;
+}
+
+inline bool powerOf2(int p) { return (p & (p-1)) == 0 ; }
+
+// An All to All collective algorithm
+typedef void (*collective_algorithm)(const void *send_buffer, void *recv_buffer, int count,
+                                     MPI_Datatype type, MPI_Comm comm) ;
+
+// The implementations of All to All Broadcast
+void AllToAllHypercube(const void *send_value, void *recv_buffer, int count, MPI_Datatype type, MPI_Comm comm) ;
+void AllToAllRing(const void *send_value, void *recv_buffer, int count, MPI_Datatype type, MPI_Comm comm) ;
+void AllToAllPipelined(const void *send_value, void *recv_buffer, int count, MPI_Datatype type, MPI_Comm comm) ;
+void AllToAllBruck(const void *send_value, void *recv_buffer, int count, MPI_Datatype type, MPI_Comm comm) ;
+void AllToAllHierarchical(const void *send_value, void *recv_buffer, int count, MPI_Datatype type, MPI_Comm comm) ;
+
+// Bytes per segment of the pipelined ring, rounded down to whole elements
+extern size_t pipeline_segment ;
+
+// The implementations of All to All Personalized Broadcast
+void AllToAllPersonalizedMesh(const void *send_buffer, void *recv_buffer, int count, MPI_Datatype type, MPI_Comm comm) ;
+void AllToAllPersonalizedBruck(const void *send_buffer, void *recv_buffer, int count, MPI_Datatype type, MPI_Comm comm) ;
+void AllToAllPersonalizedPairwise(const void *send_buffer, void *recv_buffer, int count, MPI_Datatype type, MPI_Comm comm) ;
+
+/******************************************************************************
+* The implemented variants, by the name used in the tuning table.  A variant  *
+* that needs a power of 2 processors is never selected otherwise.             *
+******************************************************************************/
+struct algorithm_variant {
+    const char *name ;
+    collective_algorithm algorithm ;
+    bool any_procs ;                        // false if it needs a power of 2 processors
+} ;
+
+extern const algorithm_variant alltoall_variants[] ;
+extern const int alltoall_count ;
+extern const algorithm_variant personalized_variants[] ;
+extern const int personalized_count ;
+
+// The variant called name if it can run on procs processors, otherwise 0
+collective_algorithm findVariant(const algorithm_variant variants[], int count, int procs, const char *name) ;
+
+// The selection used by AllToAll and AllToAllPersonalized.  Its entries
+// apply to communicators of the size it was measured or loaded for.
+extern tuning_table tuning ;
+
+// The collectives, using the algorithm the tuning table selects for the
+// size of the message
+void AllToAll(const void *send_value, void *recv_buffer, int count, MPI_Datatype type, MPI_Comm comm) ;
+void AllToAllPersonalized(const void *send_buffer, void *recv_buffer, int count, MPI_Datatype type, MPI_Comm comm) ;
+
+template<class T> void AllToAll(const T send_value[], T recv_buffer[], int size, MPI_Comm comm) {
+    AllToAll(send_value, recv_buffer, size, mpi_datatype<T>::get(), comm) ;
+}
+
+template<class T> void AllToAllPersonalized(const T send_buffer[], T recv_buffer[], int size, MPI_Comm comm) {
+    AllToAllPersonalized(send_buffer, recv_buffer, size, mpi_datatype<T>::get(), comm) ;
+}
+
+void AllToAll(int send_value[], int recv_buffer[], int size, MPI_Comm comm) ;
+void AllToAllPersonalized(int send_buffer[], int recv_buffer[], int size, MPI_Comm comm) ;
+
+/******************************************************************************
+* All to All Personalized Broadcast with a different number of elements for   *
+* each pair of processors.  Processor s sends send_counts[d] elements from     *
+* send_buffer+send_displs[d] to processor d, and receives recv_counts[s]       *
+* elements at recv_buffer+recv_displs[s] (displacements in elements).  The    *
+* receive counts come from AllToAllCounts, which the caller runs first to     *
+* size the receive buffer.  Only the elements sent travel, nothing is padded. *
+*                                                                             *
+* The hypercube variant needs a power of 2 processors.  It starts by sharing  *
+* every processor's counts, so each step knows the size of every block it     *
+* forwards, and takes log2(p) steps, which suits small irregular exchanges.   *
+* The pairwise variant sends every block directly in p-1 steps.               *
+******************************************************************************/
+
+// Exchange the counts: recv_counts[s] is the send_counts[myid] of processor s
+void AllToAllCounts(const int send_counts[], int recv_counts[], MPI_Comm comm) ;
+
+void AllToAllPersonalizedvHypercube(const void *send_buffer, const int send_counts[], const int send_displs[],
+                                    void *recv_buffer, const int recv_counts[], const int recv_displs[],
+                                    MPI_Datatype type, MPI_Comm comm) ;
+void AllToAllPersonalizedvPairwise(const void *send_buffer, const int send_counts[], const int send_displs[],
+                                   void *recv_buffer, const int recv_counts[], const int recv_displs[],
+                                   MPI_Datatype type, MPI_Comm comm) ;
+
+// The hypercube on a power of 2 processors for small blocks, pairwise otherwise
+void AllToAllPersonalizedv(const void *send_buffer, const int send_counts[], const int send_displs[],
+                           void *recv_buffer, const int recv_counts[], const int recv_displs[],
+                           MPI_Datatype type, MPI_Comm comm) ;
+
+template<class T> void AllToAllPersonalizedv(const T send_buffer[], const int send_counts[], const int send_displs[],
+                                             T recv_buffer[], const int recv_counts[], const int recv_displs[],
+                                             MPI_Comm comm) {
+    AllToAllPersonalizedv((const void *)send_buffer, send_counts, send_displs, (void *)recv_buffer,
+                          recv_counts, recv_displs, mpi_datatype<T>::get(), comm) ;
+}
+
+/******************************************************************************
+* A non-blocking collective in progress.  IAllToAll and                       *
+* IAllToAllPersonalized post the first step of the hypercube schedule and     *
+* return; Test advances the schedule as far as the messages received allow    *
+* and Wait completes it, so the caller can compute between calls to Test.     *
+* Each step is posted with MPI_Isend and MPI_Irecv once the step before has   *
+* completed, since it sends what that step received.                          *
+*                                                                             *
+* The send and receive buffers must not be touched until the collective has   *
+* completed.  Every processor must start the collectives on a communicator    *
+* in the same order.  They exchange their messages over a duplicate of the    *
+* communicator kept in its collective_context, each with tags of its own, so  *
+* up to 64 may be in progress on a communicator at once, together with        *
+* blocking collectives and point to point messages; starting more aborts.     *
+* Collectives must complete before the communicator is freed.  A request      *
+* keeps its buffers, so reusing one request for a series of collectives does  *
+* not allocate each time.  It waits for a collective still in progress when   *
+* it is destroyed.                                                            *
+******************************************************************************/
+class collective_request {
+public:
+    collective_request() ;
+    ~collective_request() ;
+
+    // Advance the collective, returns true once it has completed
+    bool Test() ;
+    // Complete the collective
+    void Wait() ;
+    // True while a collective is in progress
+    bool active() const { return kind != DONE ; }
+
+private:
+    friend void IAllToAll(const void *, void *, int, MPI_Datatype, MPI_Comm, collective_request &) ;
+    friend void IAllToAllPersonalized(const void *, void *, int, MPI_Datatype, MPI_Comm, collective_request &) ;
+
+    enum schedule {DONE, HYPERCUBE, MESH, BRUCK} ;
+
+    collective_request(const collective_request &) ;
+    void Start(schedule k, const void *send_buffer, void *recv_buffer, int count,
+               MPI_Datatype type, MPI_Comm comm) ;
+    // Post the current step, skipping the steps with nothing to exchange,
+    // and finish the collective after the last one
+    void startStep() ;
+    // Use what the current step received
+    void finishStep() ;
+    char *buffer(int k, size_t bytes) ;
+
+    schedule kind ;
+    const char *send ;
+    char *recv ;
+    int count ;
+    MPI_Datatype type ;
+    MPI_Comm comm ;                         // Duplicate of the caller's communicator
+    class collective_context *context ;
+    int slot, tag ;                         // Tag slot and first tag of the collective
+    int numprocs, myid ;
+    size_t block ;                          // Bytes of one block
+    int step, steps ;                       // Current step and number of steps
+    int half, virtual_id ;                  // Hypercube with virtual processors
+    bool has_virtual_id ;
+    MPI_Request requests[2] ;
+    char *buffers[3] ;                      // Working, received and packed blocks
+    size_t sizes[3] ;
+} ;
+
+// Start the All to All Broadcast with the hypercube schedule
+void IAllToAll(const void *send_value, void *recv_buffer, int count, MPI_Datatype type, MPI_Comm comm,
+               collective_request &request) ;
+// Start the All to All Personalized Broadcast, with the mesh schedule on a
+// power of 2 processors and Bruck's schedule otherwise
+void IAllToAllPersonalized(const void *send_buffer, void *recv_buffer, int count, MPI_Datatype type, MPI_Comm comm,
+                           collective_request &request) ;
+
+template<class T> void IAllToAll(const T send_value[], T recv_buffer[], int size, MPI_Comm comm,
+                                 collective_request &request) {
+    IAllToAll(send_value, recv_buffer, size, mpi_datatype<T>::get(), comm, request) ;
+}
+
+template<class T> void IAllToAllPersonalized(const T send_buffer[], T recv_buffer[], int size, MPI_Comm comm,
+                                             collective_request &request) {
+    IAllToAllPersonalized(send_buffer, recv_buffer, size, mpi_datatype<T>::get(), comm, request) ;
+}
+
+#endif
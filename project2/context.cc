@@ -0,0 +1,179 @@
+#include "context.h"
+
+// Standard Includes for C and OS calls
+#include <algorithm>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Keyval of the context attribute, created on first use
+static int context_keyval = MPI_KEYVAL_INVALID ;
+
+// Called by MPI when a communicator with a context is freed
+static int deleteContext(MPI_Comm, int, void *attribute, void *) {
+    delete (collective_context *)attribute ;
+    return MPI_SUCCESS ;
+}
+
+collective_context &collective_context::Get(MPI_Comm comm) {
+    if (context_keyval == MPI_KEYVAL_INVALID)
+        MPI_Comm_create_keyval(MPI_COMM_NULL_COPY_FN, deleteContext, &context_keyval, 0) ;
+
+    collective_context *context ;
+    int found ;
+    MPI_Comm_get_attr(comm, context_keyval, &context, &found) ;
+    if (!found) {
+        context = new collective_context ;
+        MPI_Comm_set_attr(comm, context_keyval, context) ;
+    }
+    return *context ;
+}
+
+void collective_context::Release(MPI_Comm comm) {
+    if (context_keyval == MPI_KEYVAL_INVALID)
+        return ;
+    collective_context *context ;
+    int found ;
+    MPI_Comm_get_attr(comm, context_keyval, &context, &found) ;
+    if (found)
+        MPI_Comm_delete_attr(comm, context_keyval) ;
+}
+
+collective_context::collective_context() {
+    for (int k=0; k<SCRATCH_BUFFERS; ++k) {
+        buffers[k] = 0 ;
+        sizes[k] = 0 ;
+    }
+    nodes = 0 ;
+    window = MPI_WIN_NULL ;
+    window_base = 0 ;
+    window_size = 0 ;
+    window_turn = 0 ;
+    request_comm = MPI_COMM_NULL ;
+    request_sequence = 0 ;
+    for (int k=0; k<REQUEST_SLOTS; ++k)
+        slot_busy[k] = false ;
+}
+
+collective_context::~collective_context() {
+    for (int k=0; k<SCRATCH_BUFFERS; ++k)
+        free(buffers[k]) ;
+
+    // The communicators and window go with MPI if it is already finalized
+    int finalized ;
+    MPI_Finalized(&finalized) ;
+    if (!finalized) {
+        if (window != MPI_WIN_NULL) {
+            MPI_Win_unlock_all(window) ;
+            MPI_Win_free(&window) ;
+        }
+        if (request_comm != MPI_COMM_NULL)
+            MPI_Comm_free(&request_comm) ;
+        if (nodes != 0) {
+            if (nodes->leaders != MPI_COMM_NULL)
+                MPI_Comm_free(&nodes->leaders) ;
+            MPI_Comm_free(&nodes->node) ;
+        }
+    }
+    delete nodes ;
+}
+
+const collective_context::node_layout &collective_context::layout(MPI_Comm comm) {
+    if (nodes != 0)
+        return *nodes ;
+
+    nodes = new node_layout ;
+    int rank, procs ;
+    MPI_Comm_rank(comm, &rank) ;
+    MPI_Comm_size(comm, &procs) ;
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &nodes->node) ;
+    MPI_Comm_rank(nodes->node, &nodes->node_rank) ;
+    MPI_Comm_size(nodes->node, &nodes->node_size) ;
+    MPI_Comm_split(comm, nodes->node_rank == 0 ? 0 : MPI_UNDEFINED, rank, &nodes->leaders) ;
+
+    // Nodes are numbered by the rank of their leader among the leaders
+    int node_id = 0 ;
+    if (nodes->leaders != MPI_COMM_NULL)
+        MPI_Comm_rank(nodes->leaders, &node_id) ;
+    MPI_Bcast(&node_id, 1, MPI_INT, 0, nodes->node) ;
+
+    int mine[2] = {node_id, nodes->node_rank} ;
+    std::vector<int> all(2*procs) ;
+    MPI_Allgather(mine, 2, MPI_INT, &all[0], 2, MPI_INT, comm) ;
+    nodes->node_count = 0 ;
+    nodes->max_node_size = 0 ;
+    for (int p=0; p<procs; ++p) {
+        if (all[2*p] >= nodes->node_count)
+            nodes->node_count = all[2*p]+1 ;
+        if (all[2*p+1] >= nodes->max_node_size)
+            nodes->max_node_size = all[2*p+1]+1 ;
+    }
+    nodes->origin.assign(nodes->node_count*nodes->max_node_size, -1) ;
+    for (int p=0; p<procs; ++p)
+        nodes->origin[all[2*p]*nodes->max_node_size + all[2*p+1]] = p ;
+    return *nodes ;
+}
+
+char *collective_context::shared(MPI_Comm comm, size_t bytes) {
+    window_turn ^= 1 ;
+    if (bytes <= window_size)
+        return window_base + window_turn*window_size ;
+    const node_layout &l = layout(comm) ;
+    if (window != MPI_WIN_NULL) {
+        MPI_Win_unlock_all(window) ;
+        MPI_Win_free(&window) ;
+    }
+
+    // The first processor of the node holds the memory and the
+    // others map it.  The window stays open for loads and stores.
+    size_t page = sysconf(_SC_PAGESIZE) ;
+    size_t rounded = (bytes+page-1)/page*page ;
+    void *base ;
+    MPI_Win_allocate_shared(l.node_rank == 0 ? 2*rounded : 0, 1, MPI_INFO_NULL, l.node, &base, &window) ;
+    MPI_Aint size ;
+    int unit ;
+    MPI_Win_shared_query(window, 0, &size, &unit, &base) ;
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, window) ;
+    window_base = (char *)base ;
+    window_size = rounded ;
+    return window_base + window_turn*window_size ;
+}
+
+MPI_Comm collective_context::requestComm(MPI_Comm comm) {
+    if (request_comm == MPI_COMM_NULL)
+        MPI_Comm_dup(comm, &request_comm) ;
+    return request_comm ;
+}
+
+int collective_context::claimSlot(int span) {
+    // As many slots as there are tags for, up to REQUEST_SLOTS
+    int *tag_ub, found ;
+    MPI_Comm_get_attr(request_comm, MPI_TAG_UB, &tag_ub, &found) ;
+    long long slots = found ? ((long long)*tag_ub+1)/span : 1 ;
+    slots = std::max(1LL, std::min(slots, (long long)REQUEST_SLOTS)) ;
+    int slot = request_sequence++ % slots ;
+    if (slot_busy[slot])
+        return -1 ;
+    slot_busy[slot] = true ;
+    return slot ;
+}
+
+void collective_context::nodeSync() {
+    MPI_Win_sync(window) ;
+    MPI_Barrier(nodes->node) ;
+    MPI_Win_sync(window) ;
+}
+
+void *collective_context::scratchBytes(scratch_buffer k, size_t bytes) {
+    if (bytes <= sizes[k])
+        return buffers[k] ;
+    free(buffers[k]) ;
+    buffers[k] = 0 ;
+    size_t page = sysconf(_SC_PAGESIZE) ;
+    size_t rounded = (bytes+page-1)/page*page ;
+    if (posix_memalign(&buffers[k], page, rounded) != 0) {
+        sizes[k] = 0 ;
+        MPI_Abort(MPI_COMM_WORLD, -1) ;
+    }
+    sizes[k] = rounded ;
+    return buffers[k] ;
+}
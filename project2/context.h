@@ -0,0 +1,100 @@
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+#include <mpi.h>
+#include <stddef.h>
+#include <vector>
+
+/******************************************************************************
+* Scratch space for the collective routines of one communicator.  The        *
+* context is created the first time a collective runs on a communicator,    *
+* stored as an attribute of the communicator and freed with it, so buffers   *
+* are reused by every later call instead of being allocated and page         *
+* faulted each time.  Buffers are page aligned and grow to the largest size  *
+* requested.                                                                 *
+*                                                                            *
+* The context also holds how the processors are spread over nodes, for the   *
+* collectives that use shared memory within a node, and a buffer shared by   *
+* the processors of each node.  Both are made on first use, which is         *
+* collective over the communicator.                                          *
+******************************************************************************/
+class collective_context {
+public:
+    // Scratch buffers that may be in use at the same time
+    enum scratch_buffer {SCRATCH_WORK, SCRATCH_RECV, SCRATCH_PACK, SCRATCH_BUFFERS} ;
+
+    // The context of comm
+    static collective_context &Get(MPI_Comm comm) ;
+    // Free the context of comm, if it has one.  Contexts of
+    // communicators that are never freed, such as MPI_COMM_WORLD, must
+    // be released before MPI_Finalize.
+    static void Release(MPI_Comm comm) ;
+
+    // Buffer k holding at least count elements of type T.  The contents
+    // are not kept when the buffer grows.
+    template<class T> T *scratch(scratch_buffer k, size_t count) {
+        return (T *)scratchBytes(k, count*sizeof(T)) ;
+    }
+
+    // The processors of a communicator grouped by node
+    struct node_layout {
+        MPI_Comm node ;                     // The processors on this node
+        MPI_Comm leaders ;                  // The first processor of each node,
+                                            // MPI_COMM_NULL on the others
+        int node_rank, node_size ;
+        int node_count ;                    // Nodes of the communicator
+        int max_node_size ;                 // Processors on the largest node
+        // Rank in the communicator of processor r of node n, at
+        // n*max_node_size+r, -1 where node n has fewer processors
+        std::vector<int> origin ;
+    } ;
+
+    // The layout of comm, which must be the communicator of the context
+    const node_layout &layout(MPI_Comm comm) ;
+
+    // A buffer of at least bytes shared by the processors of this node,
+    // mapped into each of them.  Collective over the node, every
+    // processor must ask for the same size.  Stores are made visible to
+    // the node by nodeSync.  Successive calls return two buffers in turn,
+    // so a collective can fill one while processors still read the
+    // result of the previous collective from the other.
+    char *shared(MPI_Comm comm, size_t bytes) ;
+    // Make the stores of every processor of the node to the shared
+    // buffer visible to all of them
+    void nodeSync() ;
+
+    // A duplicate of comm for the non-blocking collectives, so that
+    // their messages never match those of other operations on comm.
+    // Made on first use, which is collective over comm.
+    MPI_Comm requestComm(MPI_Comm comm) ;
+    // Claim the tag slot of the next non-blocking collective started
+    // on the communicator, when tags of span values are needed.  Slots
+    // are given out in turn, so every processor gives the same slot to
+    // the same collective.  Returns -1 if that slot is still held by a
+    // collective in progress.
+    int claimSlot(int span) ;
+    void releaseSlot(int slot) { slot_busy[slot] = false ; }
+
+    ~collective_context() ;
+
+private:
+    collective_context() ;
+    collective_context(const collective_context &) ;
+    void *scratchBytes(scratch_buffer k, size_t bytes) ;
+
+    void *buffers[SCRATCH_BUFFERS] ;
+    size_t sizes[SCRATCH_BUFFERS] ;
+
+    node_layout *nodes ;
+    MPI_Win window ;                        // Window of the shared buffers
+    char *window_base ;
+    size_t window_size ;                    // Bytes of each of the two buffers
+    int window_turn ;                       // The buffer returned last
+
+    enum {REQUEST_SLOTS = 64} ;             // Non-blocking collectives in progress at once
+    MPI_Comm request_comm ;
+    unsigned int request_sequence ;         // Non-blocking collectives started
+    bool slot_busy[REQUEST_SLOTS] ;
+} ;
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef DATATYPE_H
+#define DATATYPE_H
+
+#include <mpi.h>
+#if __cplusplus >= 201103L
+#include <type_traits>
+#endif
+
+/******************************************************************************
+* The MPI datatype of one element of type T, so the collectives can send      *
+* their callers' data as it is.  Built in types map to their MPI types.  Any  *
+* other type is sent as a contiguous run of sizeof(T) bytes, which is right   *
+* for trivially copyable structs between processors of the same              *
+* architecture.  That type is created and committed on first use and lives   *
+* until MPI_Finalize.                                                        *
+******************************************************************************/
+template<class T> struct mpi_datatype {
+    static MPI_Datatype get() {
+#if __cplusplus >= 201103L
+        static_assert(std::is_trivially_copyable<T>::value,
+                      "only trivially copyable types can be sent as bytes") ;
+#endif
+        static MPI_Datatype type = MPI_DATATYPE_NULL ;
+        if (type == MPI_DATATYPE_NULL) {
+            MPI_Type_contiguous(sizeof(T), MPI_BYTE, &type) ;
+            MPI_Type_commit(&type) ;
+        }
+        return type ;
+    }
+} ;
+
+#define MPI_DATATYPE_TRAIT(T, M) \
+    template<> struct mpi_datatype<T> { static MPI_Datatype get() { return M ; } } ;
+
+MPI_DATATYPE_TRAIT(char, MPI_CHAR)
+MPI_DATATYPE_TRAIT(signed char, MPI_SIGNED_CHAR)
+MPI_DATATYPE_TRAIT(unsigned char, MPI_UNSIGNED_CHAR)
+MPI_DATATYPE_TRAIT(short, MPI_SHORT)
+MPI_DATATYPE_TRAIT(unsigned short, MPI_UNSIGNED_SHORT)
+MPI_DATATYPE_TRAIT(int, MPI_INT)
+MPI_DATATYPE_TRAIT(unsigned int, MPI_UNSIGNED)
+MPI_DATATYPE_TRAIT(long, MPI_LONG)
+MPI_DATATYPE_TRAIT(unsigned long, MPI_UNSIGNED_LONG)
+MPI_DATATYPE_TRAIT(long long, MPI_LONG_LONG)
+MPI_DATATYPE_TRAIT(unsigned long long, MPI_UNSIGNED_LONG_LONG)
+MPI_DATATYPE_TRAIT(float, MPI_FLOAT)
+MPI_DATATYPE_TRAIT(double, MPI_DOUBLE)
+MPI_DATATYPE_TRAIT(long double, MPI_LONG_DOUBLE)
+
+#undef MPI_DATATYPE_TRAIT
+
+#endif
@@ -1,6 +1,16 @@
 #include "utilities.h"
+#include "collectives.h"
+#include "profile.h"
+#include "context.h"
 #include <mpi.h>
 #include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <vector>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
 
 using std::cerr ;
 using std::cout ;
@@ -13,375 +23,464 @@ using std::endl ;
 int numprocs, myid ; 
 
 /******************************************************************************
-* evaluate 2^i                                                                *
+* Measure every variant that can run on numprocs processors for each message  *
+* size of the sweep and add the fastest to the tuning table.  blocks is the   *
+* number of blocks of size ints each processor sends.  Every processor takes  *
+* the time of the slowest one, so all of them make the same selection.        *
 ******************************************************************************/
-inline unsigned int pow2(unsigned int i) { return 1 << i ; }
+
+void tuneCollective(tuning_table::collective c, const algorithm_variant variants[], int count,
+                    int blocks, int *send_buffer, int *recv_buffer) {
+
+    PROFILE_SCOPE("tuneCollective") ;
+
+    for(int l=0;l<=16;l+=2) {
+        int msize = pow2(l) ;
+        int runs = std::max(3, std::min(200, (int)pow2(20)/(msize*numprocs))) ;
+        for (int k=0; k<blocks*msize; ++k)
+            send_buffer[k] = myid ;
+
+        const char *best = 0 ;
+        double best_time = 0 ;
+        for (int v=0; v<count; ++v) {
+            if (!variants[v].any_procs && !powerOf2(numprocs))
+                continue ;
+            // One untimed call to set up the scratch space
+            variants[v].algorithm(send_buffer, recv_buffer, msize, MPI_INT, MPI_COMM_WORLD) ;
+            MPI_Barrier(MPI_COMM_WORLD) ;
+            double start = MPI_Wtime() ;
+            for (int i=0; i<runs; ++i)
+                variants[v].algorithm(send_buffer, recv_buffer, msize, MPI_INT, MPI_COMM_WORLD) ;
+            double time_passes = MPI_Wtime()-start, max_time ;
+            MPI_Allreduce(&time_passes, &max_time, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD) ;
+            if (best == 0 || max_time < best_time) {
+                best = variants[v].name ;
+                best_time = max_time ;
+            }
+        }
+        tuning.Add(c, msize*sizeof(int), best) ;
+        if (myid == 0) {
+            cout << "tuned m=" << msize << ": " << best << " required "
+            << best_time/double(runs) << " seconds." << endl ;
+        }
+    }
+}
 
 /******************************************************************************
-* evaluate ceil(log2(i))                                                      *
+* Settings of the benchmarks.  Messages of 2^l ints are timed for l from      *
+* first_l to last_l in steps of step_l.  Each size runs warmup untimed        *
+* iterations, then test_runs timed ones.  Rows of results are also written   *
+* to csv when it is open (on processor 0).                                    *
 ******************************************************************************/
-inline unsigned int log2(unsigned int i) {
-    i-- ;
-    unsigned int log = 1 ;
-    for(i>>=1;i!=0;i>>=1)
-        log++ ;
-    return log ;
-}
+struct benchmark_options {
+    int first_l, last_l, step_l ;
+    int warmup ;
+    int test_runs ;
+    std::ofstream csv ;
+} ;
 
 /******************************************************************************
-* This function should implement the All to All Broadcast.  The value for each*
-* processor is given by the argument send_value.  The recv_buffer argument is *
-* an array of size p that will store the values that each processor transmits.*
-* See Program 4.7 page 162 of the text.                                       *
+* Report the times of the iterations of one message size.  An iteration takes *
+* as long as its slowest processor, so the times are reduced by maximum       *
+* before taking the minimum, median and 99th percentile.  Bandwidth is the    *
+* bytes each processor receives from the others over the median time.        *
 ******************************************************************************/
 
-void AllToAll(int send_value[], int recv_buffer[], int size, MPI_Comm comm){
-    
-    // MPI_Allgather(send_value,size,MPI_INT,recv_buffer,size,MPI_INT,comm) ;
-    
-    // MPI Primitives 
-    MPI_Status status ; 
-    int TAG_SEND = 0, TAG_RECV = 0 ; 
-
-    int max_size = pow2(16) ;               // Maximum message size 
-    int dimension = log2(numprocs) ;        // Hypercube dimension
-    int proc_total = pow2(dimension) ;      // Physical & Virtual proc count
-    int partner = 0 ;                       // Hypercube partner id 
-    int virtual_id = 0 ;                    // Virtual id for non-physical procs
-    int msg_size = size ;                   // Original message size 
-    int i, j, k = 0 ;                       // Loop iterators   
-    bool has_virtual_id = false ;           // Boolean to determine if physical proc has a virtual proc
-    int host_proc = 0 ;                     // Physical processor id that's hosting a virtual processor          
-
-    // Buffers
-    int *physical_buffer = new int[proc_total*max_size] ;    // Buffer to store physical processors information
-    int *virtual_buffer = new int[proc_total*max_size] ;     // Buffer to store virtual buffer hosted on physical proc
-    int *recv_phys_msg ;                                     // Temp buffer to handle recv with physical procs
-    int *recv_virt_msg ;                                     // Temp buffer to handle recv with virtual procs
-
-    for (i=0; i<size; ++i) { 
-        physical_buffer[i] = send_value[i] ;
-        virtual_buffer[i] = send_value[i] ; 
+void reportTimes(const char *collective, const char *name, int msize, double bytes,
+                 std::vector<double> &times, benchmark_options &options) {
+
+    std::vector<double> max_times(times.size()) ;
+    MPI_Reduce(&times[0], &max_times[0], times.size(), MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD) ;
+    if (myid != 0)
+        return ;
+
+    std::sort(max_times.begin(), max_times.end()) ;
+    int runs = max_times.size() ;
+    double total = 0 ;
+    for (int i=0; i<runs; ++i)
+        total += max_times[i] ;
+    double min_time = max_times[0] ;
+    double median = max_times[runs/2] ;
+    double p99 = max_times[std::max(0, (99*runs+99)/100 - 1)] ;
+    double bandwidth = median > 0 ? bytes/median/1e6 : 0 ;
+
+    cout << collective << " (" << name << ") m=" << msize
+    << ": min " << min_time << " median " << median << " p99 " << p99
+    << " seconds, " << bandwidth << " MB/s" << endl ;
+    if (options.csv.is_open()) {
+        options.csv << collective << "," << name << "," << numprocs << "," << msize << ","
+        << bytes << "," << runs << "," << min_time << "," << median << ","
+        << p99 << "," << total/runs << "," << bandwidth << endl ;
     }
+}
 
-    // Check to see if the number of processors 
-    // is a power of 2 
-    if (numprocs > 0) {
-
-        // Boolean to determine if the number of procs 
-        // is a valid power of 2. 
-        bool power2 = ((numprocs & (numprocs - 1)) == 0) ;
-        
-        // If the supplied amount of processors is 
-        // not a power of 2 ... 
-        if (!power2) {
-
-            // Processor 0 will always be connected to physical processors;
-            // therefore, we skip it. 
-            if (myid != 0) {
-                /*
-                    Let us use the example of 3 procs. The next 
-                    power of 2 will be 4. The mapped virtual processor
-                    should be hosted on the lesser half of the 
-                    dimension divide. 
-
-                    2 --------- 3
-                    |           |           
-                    |           |
-                ---------------------         
-                    |           |
-                    |           |
-                    0 ---------- 1
-                */
-
-                // Find the next closest power of 2. 
-                int next_pow2_dim = pow2(log2(numprocs)) ; 
-
-                // Verify it falls into the lower half 
-                // of the divide 
-                if (myid < next_pow2_dim / 2) {
-
-                    // Map the virtual proc to the appropriate physical proc
-                    virtual_id = myid ^ (pow2(dimension-1)) ; 
-                    has_virtual_id = true ; 
-
-                } // end if (myid < next_pow2_dim / 2)
-            } // end if (myid != 0) 
-        } // end if (!power2) 
-    } // end if (numprocs > 0) 
-
-    // Perform All-To-All Hypercube Algorithm 
-    for(i=0; i<dimension; ++i, size*=2) {
-        
-        // Determine the communication partner 
-        partner = myid ^ pow2(i) ; 
-
-        // Temp buffers to handle messages 
-        recv_phys_msg = new int[numprocs*max_size];
-        recv_virt_msg = new int[numprocs*max_size];
-    
-        // Current physical processor is hosting a virtual
-        // procssor and attempting to communicate with the 
-        // virtual proc. 
-        if ((partner == virtual_id) && has_virtual_id) {
-
-            // Append the virtual proc message 
-            // before the physical proc message 
-            if (myid > partner) {
-                for (j=0; j<size; ++j) {
-                    physical_buffer[j+size] = physical_buffer[j] ; 
-                    physical_buffer[j] = virtual_buffer[j] ; 
-                }
+/******************************************************************************
+* Time an All to All Broadcast algorithm over the message sizes of the        *
+* benchmark and check what every processor receives.                          *
+******************************************************************************/
+
+void benchmarkAllToAll(const char *name, collective_algorithm algorithm, benchmark_options &options,
+                       int *send_buffer, int *recv_buffer) {
+
+    PROFILE_SCOPE("benchmarkAllToAll") ;
+    std::vector<double> times(options.test_runs) ;
+
+    // Do not proceed until all processors 
+    // are ready 
+    MPI_Barrier(MPI_COMM_WORLD) ;
+
+    for(int l=options.first_l;l<=options.last_l;l+=options.step_l) {
+
+        int msize = pow2(l) ;
+
+        // Warm up the buffers, connections and scratch space
+        for(int i=0;i<options.warmup;++i) {
+            algorithm(send_buffer,recv_buffer,msize,MPI_INT,MPI_COMM_WORLD) ;
+        }
+
+        // Loop until the test runs are completed
+        for(int i=0;i<options.test_runs;++i) {
+
+            // Slow All-to-All broadcast using p single node broadcasts
+            for(int p=0;p<numprocs;++p) {
+                recv_buffer[p*msize] = 0 ;
+            }
+
+            // Create a unique message (int)
+            int send_info = myid + i*numprocs ;
+
+            // Populate the send buffer 
+            // with the unique message 
+            for(int k=0;k<msize;++k) {
+                send_buffer[k] = send_info ;
             }
 
-            // Otherwise, append after the virtual proc
-            // message 
-            else {
-                for (j=0; j<size; ++j) {
-                    physical_buffer[j+size] = virtual_buffer[j] ; 
+            // Perform the All-to-All broadcast algorithm, every
+            // processor starting together
+            MPI_Barrier(MPI_COMM_WORLD) ;
+            double start = MPI_Wtime() ;
+            algorithm(send_buffer,recv_buffer,msize,MPI_INT,MPI_COMM_WORLD) ;
+            times[i] = MPI_Wtime() - start ;
+
+            // Verify that the received message matches 
+            // what is to be expected 
+            for(int p=0;p<numprocs;++p) {
+	            if(recv_buffer[p*msize] != (p + i*numprocs)) {
+                    cerr << "recv failed on processor " << myid << " recv_buffer["
+                    << p << "] = "
+                    << recv_buffer[p*msize] << " should  be " << p + i*numprocs << endl ;
                 }
             }
         }
 
-        // Handle physical to physical and 
-        // physical to virtual processors 
-        else {
+        reportTimes("all to all broadcast", name, msize, double(numprocs-1)*msize*sizeof(int),
+                    times, options) ;
+    }
+}
 
-            // Physical proc to physical proc communication 
-            if (numprocs > partner) {
-                TAG_SEND = partner ; 
-                TAG_RECV = myid ; 
-                
-                MPI_Sendrecv(physical_buffer, max_size*numprocs, MPI_INT, partner, TAG_SEND, 
-                    recv_phys_msg, max_size*numprocs, MPI_INT, partner, TAG_RECV, comm, &status) ; 
-
-                if (myid > partner) {
-                    for (j=0; j<size; ++j) {
-                        physical_buffer[j+size] = physical_buffer[j] ; 
-                        physical_buffer[j] = recv_phys_msg[j] ; 
-                    }
-                }
+/******************************************************************************
+* Time an All to All Personalized Broadcast algorithm over the message sizes *
+* of the benchmark and check what every processor receives.                  *
+******************************************************************************/
 
-                else {
-                    for (j=0; j<size; ++j) {
-                        physical_buffer[j+size] = recv_phys_msg[j] ; 
-                    }
+void benchmarkPersonalized(const char *name, collective_algorithm algorithm, benchmark_options &options,
+                           int *send_buffer, int *recv_buffer) {
+
+    PROFILE_SCOPE("benchmarkPersonalized") ;
+    std::vector<double> times(options.test_runs) ;
+
+    // Barrier to ensure that we finish all of the following 
+    // above, and that all the nodes are ready to proceed before
+    // executing the All to All personlized algorithm. 
+    MPI_Barrier(MPI_COMM_WORLD) ;
+
+    for(int l=options.first_l;l<=options.last_l;l+=options.step_l) {
+        int msize = pow2(l) ;
+
+        for(int i=0;i<options.warmup;++i) {
+            algorithm(send_buffer,recv_buffer,msize,MPI_INT,MPI_COMM_WORLD) ;
+        }
+
+        for(int i=0;i<options.test_runs;++i) {
+            for(int p=0;p<numprocs;++p) {
+	            for(int k=0;k<msize;++k) {
+                    recv_buffer[p*msize+k] = 0 ;
                 }
             }
-
-            // Physical proc to virtual proc communication 
-            else {
-                
-                // Determine the physical processor that
-                // has the virtual partner 
-                host_proc = partner ^ pow2(dimension-1);
-                TAG_SEND = partner ; 
-                TAG_RECV = myid ; 
-        
-                // A physical processor needs to communicate with a virtual processor, so 
-                // we must send the message to the physical (host) location. The host must
-                // take on the role of the virtual process and handle the communication. 
-                MPI_Sendrecv(physical_buffer, max_size*numprocs, MPI_INT, host_proc, TAG_SEND, 
-                    recv_phys_msg, max_size*numprocs, MPI_INT, host_proc, TAG_RECV, comm, &status);
-
-                if (myid > partner) {
-                    for (j=0; j<size; ++j) {
-                        physical_buffer[j+size] = physical_buffer[j] ; 
-                        physical_buffer[j] = recv_phys_msg[j] ; 
-                    }
+      
+            int factor = (myid&1==1)?-1:1 ;
+            for(int p=0;p<numprocs;++p) {
+	            for(int k=0;k<msize;++k) {
+                    send_buffer[p*msize+k]=myid*numprocs + p + i*myid*myid*factor;
                 }
+            }
 
-                else {
-                    for (j=0; j<size; ++j) {
-                        physical_buffer[j+size] = recv_phys_msg[j] ; 
-                    }
+            MPI_Barrier(MPI_COMM_WORLD) ;
+            double start = MPI_Wtime() ;
+            algorithm(send_buffer,recv_buffer,msize,MPI_INT,MPI_COMM_WORLD) ;
+            times[i] = MPI_Wtime() - start ;
+    
+            for(int p=0;p<numprocs;++p) {
+                int factor = (p&1==1)?-1:1 ;
+                if(recv_buffer[p*msize] != ( p*numprocs + myid + i*p*p*factor )) {
+                    cerr << "recv failed on processor " << myid << " recv_buffer["
+                    << p << "] = "
+                    << recv_buffer[p*msize] << " should  be " << p*numprocs + myid + i*p*p*factor << endl ;
                 }
             }
         }
 
-        // After this process has handled its physical process, 
-        // the virtual process it is hosting must be handled. 
-        if (has_virtual_id) {
-
-            partner = virtual_id ^ pow2(i) ; 
-
-            // Check to make sure this processor 
-            // is not trying to communicate with 
-            // the virtual processor it is hosting
-            if (myid != partner) {
-
-                // Virtual proc to physical proc communication 
-                if (partner < numprocs) {
-                    
-                    TAG_SEND = partner ; 
-                    TAG_RECV = virtual_id ; 
-
-                    MPI_Sendrecv(virtual_buffer, max_size*numprocs, MPI_INT, partner, TAG_SEND, 
-                        recv_virt_msg, max_size*numprocs, MPI_INT, partner, TAG_RECV, comm, &status);
-                    
-                    if (virtual_id > partner) {
-                        for (j=0; j<size; ++j) {
-                            virtual_buffer[j+size] = virtual_buffer[j] ; 
-                            virtual_buffer[j] = recv_virt_msg[j] ; 
-                        }
-                    }
-
-                    else {
-                        for (j=0; j<size; ++j) {
-                            virtual_buffer[j+size] = recv_virt_msg[j] ; 
-                        }
-                    }
-                }
+        reportTimes("all-to-all-personalized broadcast", name, msize, double(numprocs-1)*msize*sizeof(int),
+                    times, options) ;
+    }
+}
+
+/******************************************************************************
+* The collectives of the MPI library, as baselines for the benchmarks         *
+******************************************************************************/
+
+void LibraryAllgather(const void *send_buffer, void *recv_buffer, int count, MPI_Datatype type, MPI_Comm comm) {
+    MPI_Allgather(send_buffer, count, type, recv_buffer, count, type, comm) ;
+}
+
+void LibraryAlltoall(const void *send_buffer, void *recv_buffer, int count, MPI_Datatype type, MPI_Comm comm) {
+    MPI_Alltoall(send_buffer, count, type, recv_buffer, count, type, comm) ;
+}
+
+void LibraryAlltoallv(const void *send_buffer, const int send_counts[], const int send_displs[],
+                      void *recv_buffer, const int recv_counts[], const int recv_displs[],
+                      MPI_Datatype type, MPI_Comm comm) {
+    MPI_Alltoallv(send_buffer, send_counts, send_displs, type,
+                  recv_buffer, recv_counts, recv_displs, type, comm) ;
+}
 
-                // Check to see if the virtual processor
-                // is attempting to communicate with
-                // another virtual processor 
-                else {
-                    host_proc = partner ^ pow2(dimension - 1);
-                    TAG_SEND = partner ; 
-                    TAG_RECV = virtual_id ; 
-                    
-                    //cout << "before" << endl ; 
-                    MPI_Sendrecv(virtual_buffer, max_size*numprocs, MPI_INT, host_proc, TAG_SEND, 
-                        recv_virt_msg, max_size*numprocs, MPI_INT, host_proc, TAG_RECV, comm, &status);
-
-                    //cout << "not stuck " << endl ; 
-                    if (virtual_id > partner) {
-                        for (j=0; j<size; ++j) {
-                            virtual_buffer[j+size] = virtual_buffer[j] ; 
-                            virtual_buffer[j] = recv_virt_msg[j] ; 
-                        }
-                    }
-
-                    else {
-                        for (j=0; j<size; ++j) {
-                            virtual_buffer[j+size] = recv_virt_msg[j] ; 
-                        }
-                    }
+// A variable count All to All Personalized Broadcast algorithm
+typedef void (*variable_algorithm)(const void *send_buffer, const int send_counts[], const int send_displs[],
+                                   void *recv_buffer, const int recv_counts[], const int recv_displs[],
+                                   MPI_Datatype type, MPI_Comm comm) ;
+
+/******************************************************************************
+* The count processor source sends to dest in the variable count benchmark,  *
+* from none to msize ints so the exchange is irregular                        *
+******************************************************************************/
+inline int variableCount(int source, int dest, int msize) {
+    return int((long long)msize*((source + 2*dest) % 4)/3) ;
+}
+
+/******************************************************************************
+* Time a variable count All to All Personalized Broadcast algorithm, m being  *
+* the largest count, and check the first and last element of every block.    *
+* The counts are exchanged with AllToAllCounts outside the timing, as a       *
+* caller sizing its receive buffer would.                                     *
+******************************************************************************/
+
+void benchmarkPersonalizedv(const char *name, variable_algorithm algorithm, benchmark_options &options,
+                            int *send_buffer, int *recv_buffer) {
+
+    PROFILE_SCOPE("benchmarkPersonalizedv") ;
+    std::vector<double> times(options.test_runs) ;
+    std::vector<int> send_counts(numprocs), send_displs(numprocs) ;
+    std::vector<int> recv_counts(numprocs), recv_displs(numprocs) ;
+
+    MPI_Barrier(MPI_COMM_WORLD) ;
+
+    for(int l=options.first_l;l<=options.last_l;l+=options.step_l) {
+        int msize = pow2(l) ;
+
+        int offset = 0 ;
+        for(int p=0;p<numprocs;++p) {
+            send_counts[p] = variableCount(myid, p, msize) ;
+            send_displs[p] = offset ;
+            offset += send_counts[p] ;
+        }
+        AllToAllCounts(&send_counts[0], &recv_counts[0], MPI_COMM_WORLD) ;
+        offset = 0 ;
+        for(int p=0;p<numprocs;++p) {
+            recv_displs[p] = offset ;
+            offset += recv_counts[p] ;
+        }
+
+        for(int i=0;i<options.warmup;++i) {
+            algorithm(send_buffer,&send_counts[0],&send_displs[0],
+                      recv_buffer,&recv_counts[0],&recv_displs[0],MPI_INT,MPI_COMM_WORLD) ;
+        }
+
+        for(int i=0;i<options.test_runs;++i) {
+            for(int p=0;p<numprocs;++p) {
+                for(int k=0;k<send_counts[p];++k) {
+                    send_buffer[send_displs[p]+k] = myid*numprocs + p + i ;
+                }
+                for(int k=0;k<recv_counts[p];++k) {
+                    recv_buffer[recv_displs[p]+k] = -1 ;
                 }
             }
 
-            // The physical (hosting) process is communicating 
-            // with the virtual (hosted) process. For this, we 
-            // do not need to using a send/recv call because
-            // the buffer is stored locally. 
-            else {
-
-                if (virtual_id > myid) {
-                    for (j=0; j<size; ++j) {
-                        virtual_buffer[j+size] = virtual_buffer[j] ; 
-                        virtual_buffer[j] = physical_buffer[j] ; 
-                    }
+            MPI_Barrier(MPI_COMM_WORLD) ;
+            double start = MPI_Wtime() ;
+            algorithm(send_buffer,&send_counts[0],&send_displs[0],
+                      recv_buffer,&recv_counts[0],&recv_displs[0],MPI_INT,MPI_COMM_WORLD) ;
+            times[i] = MPI_Wtime() - start ;
+
+            for(int p=0;p<numprocs;++p) {
+                int expected = p*numprocs + myid + i ;
+                if(recv_counts[p] != variableCount(p, myid, msize) ||
+                   (recv_counts[p] > 0 && (recv_buffer[recv_displs[p]] != expected ||
+                                           recv_buffer[recv_displs[p]+recv_counts[p]-1] != expected))) {
+                    cerr << "recv failed on processor " << myid << " block from " << p
+                    << " of " << recv_counts[p] << " ints" << endl ;
                 }
+            }
+        }
 
-                else {
-                    for (j=0; j<size; ++j) {
-                        virtual_buffer[j+size] = physical_buffer[j] ; 
-                    }
+        // The mean over processors of the ints received from others
+        double received = 0 ;
+        for(int s=0;s<numprocs;++s) {
+            for(int d=0;d<numprocs;++d) {
+                if (s != d) {
+                    received += variableCount(s, d, msize) ;
                 }
             }
         }
+        reportTimes("all-to-all-personalized-v broadcast", name, msize, received/numprocs*sizeof(int),
+                    times, options) ;
+    }
+}
 
-        delete[] recv_phys_msg ; delete[] recv_virt_msg;
+/******************************************************************************
+* A synthetic compute kernel standing in for the work an application does     *
+* while an exchange is in progress.  Each unit is a fixed chain of floating   *
+* point operations; the result is kept so the work is not optimized away.     *
+******************************************************************************/
 
-    }
+double kernel_result = 0 ;
 
-    // Relocate the buffer contents to the original
-    // recv_buffer so that we can properly check the 
-    // indices locations. 
-    for (i = 0; i<numprocs*msg_size; ++i){
-        recv_buffer[i] = physical_buffer[i];
+void computeKernel(int units) {
+    double x = kernel_result ;
+    for (int u=0; u<units; ++u) {
+        for (int k=0; k<100; ++k) {
+            x = x*0.999999 + 1.0 ;
+        }
     }
-
-    delete[] physical_buffer ; delete[] virtual_buffer ;
+    kernel_result = x ;
 }
 
+// A non-blocking All to All collective
+typedef void (*nonblocking_algorithm)(const void *send_buffer, void *recv_buffer, int count,
+                                      MPI_Datatype type, MPI_Comm comm, collective_request &request) ;
+
 /******************************************************************************
-* This function should implement the All to All Personalized Broadcast.       *
-* A value destined for each processor is given by the argument array          *
-* send_buffer of size p.  The recv_buffer argument is an array of size p      *
-* that will store the values that each processor transmits.                   *
-* See pages 175-179 in the text.                                              *
+* Measure how much of a non-blocking collective is hidden behind computation. *
+* For each message size the exchange is timed alone, then the compute kernel  *
+* is timed alone and resized until it takes as long as the exchange, then     *
+* both are run together with the kernel split into chunks and the request     *
+* tested between chunks.  The hidden fraction is the time saved over running  *
+* them one after the other, relative to the time of the exchange.  It is     *
+* reported with the ratio of the compute time to the exchange time.           *
 ******************************************************************************/
 
-void AllToAllPersonalized(int send_buffer[], int recv_buffer[], int size, MPI_Comm comm) {
-    
-    // MPI_Alltoall(send_buffer,size,MPI_INT,recv_buffer,size,MPI_INT,comm) ;
-    
-    // Both flags CANNOT be set true at the same time. 
-    bool run_e_cube_alg = false ; 
-    bool run_mesh_alg = true ; 
-
-    // MPI Primitives 
-    MPI_Status status ; 
-    int TAG_SEND = 0 ;
-    int TAG_RECV = 0 ; 
+// Rounds of resizing the compute kernel, and how close to the exchange
+// time the kernel must come
+const int CALIBRATION_ROUNDS = 8 ;
+const double CALIBRATION_TOLERANCE = 0.1 ;
 
-    int partner = 0 ; 
-    int max_size = pow2(16) ; 
-    int i, j, k = 0 ;
-    int dimension = log2(numprocs) ; 
+void benchmarkOverlap(const char *name, nonblocking_algorithm algorithm, bool personalized,
+                      benchmark_options &options, int *send_buffer, int *recv_buffer) {
 
-    // Perform E-Cube Routing Algorithm 
-    if (run_e_cube_alg) {
+    PROFILE_SCOPE("benchmarkOverlap") ;
+    const int chunks = 16 ;
+    int test_runs = options.test_runs ;
+    collective_request request ;
 
-        for (i=1; i < numprocs; ++i) {
-            
-            partner = myid ^ i;
-
-            MPI_Sendrecv(send_buffer, numprocs*max_size, MPI_INT, partner, TAG_SEND, 
-                recv_buffer, numprocs*max_size, MPI_INT, partner, TAG_RECV, comm, &status);
+    MPI_Barrier(MPI_COMM_WORLD) ;
 
-            for (j=0; j<size; ++j) {
-                send_buffer[partner*size + j] = recv_buffer[myid*size + j] ; 
+    for(int l=options.first_l;l<=options.last_l;l+=options.step_l) {
+        int msize = pow2(l) ;
+        for(int p=0;p<numprocs;++p) {
+            for(int k=0;k<msize;++k) {
+                send_buffer[p*msize+k] = personalized ? myid*numprocs + p : myid ;
+                recv_buffer[p*msize+k] = -1 ;
             }
         }
 
-        // Copy the final values to the recv_buffer
-        for (i=0; i<size*numprocs; ++i) {
-            recv_buffer[i] = send_buffer[i] ; 
+        // The exchange alone
+        MPI_Barrier(MPI_COMM_WORLD) ;
+        double start = MPI_Wtime() ;
+        for(int i=0;i<test_runs;++i) {
+            algorithm(send_buffer,recv_buffer,msize,MPI_INT,MPI_COMM_WORLD,request) ;
+            request.Wait() ;
         }
-    }
-
-    // Perform Mesh Algorithm 
-    if (run_mesh_alg) {
- 
-        // This works similiarly to the setup of the 
-        // traditional hypercube algorithm. 
-        for (i=0; i<dimension; ++i) {
-
-            // Establish partner id 
-            partner = myid ^ pow2(i) ;
-            
-            
-            int next = pow2(i) * size ; 
-
-            MPI_Sendrecv(send_buffer, max_size*numprocs, MPI_INT, partner, TAG_SEND, 
-                recv_buffer, max_size*numprocs, MPI_INT, partner, TAG_RECV, comm, &status) ; 
-
-            // Perform the shuffle pattern
-            // The data is contiguous, so we can shuffle information 
-            // by its chunks of data
-            if (myid < partner) {
-                for (j=next; j<size*numprocs; j+=next*2) {
-                    for (k=0; k<next; ++k) {
-                        send_buffer[j+k] = recv_buffer[j-next+k] ; 
-                    }
-                }
+        double time_passes = MPI_Wtime()-start, exchange_time ;
+        MPI_Allreduce(&time_passes, &exchange_time, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD) ;
+        exchange_time /= double(test_runs) ;
+
+        // Estimate the kernel size that takes as long as the exchange on
+        // the slowest processor
+        computeKernel(10000) ;
+        start = MPI_Wtime() ;
+        computeKernel(100000) ;
+        double unit_time = (MPI_Wtime()-start)/100000.0, max_unit_time ;
+        MPI_Allreduce(&unit_time, &max_unit_time, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD) ;
+        int units = std::max(chunks, int(exchange_time/max_unit_time)/chunks*chunks) ;
+
+        // The computation alone, timed the way it runs in the overlap
+        // loop and resized until it takes as long as the exchange.  The
+        // size that came closest is kept.
+        double compute_time = 0 ;
+        int best_units = units ;
+        for(int round=0;round<CALIBRATION_ROUNDS;++round) {
+            MPI_Barrier(MPI_COMM_WORLD) ;
+            start = MPI_Wtime() ;
+            for(int i=0;i<test_runs;++i) {
+                computeKernel(units) ;
             }
-            else {
-                for (j=0; j<size*numprocs; j+=next*2) {
-                    for (k=0; k<next; ++k) {
-                        send_buffer[j+k] = recv_buffer[j+k+next] ; 
-                    }
+            time_passes = MPI_Wtime()-start ;
+            double time ;
+            MPI_Allreduce(&time_passes, &time, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD) ;
+            time /= double(test_runs) ;
+            if(round == 0 || std::fabs(time-exchange_time) < std::fabs(compute_time-exchange_time)) {
+                compute_time = time ;
+                best_units = units ;
+            }
+            double ratio = time/exchange_time ;
+            if(ratio > 1-CALIBRATION_TOLERANCE && ratio < 1+CALIBRATION_TOLERANCE)
+                break ;
+            double scale = std::min(100.0, 1.0/std::max(ratio, 0.01)) ;
+            units = std::max(chunks, int(units*scale)/chunks*chunks) ;
+        }
+        units = best_units ;
 
-                }
+        // Both together
+        MPI_Barrier(MPI_COMM_WORLD) ;
+        start = MPI_Wtime() ;
+        for(int i=0;i<test_runs;++i) {
+            algorithm(send_buffer,recv_buffer,msize,MPI_INT,MPI_COMM_WORLD,request) ;
+            for(int c=0;c<chunks;++c) {
+                computeKernel(units/chunks) ;
+                request.Test() ;
+            }
+            request.Wait() ;
+        }
+        time_passes = MPI_Wtime()-start ;
+        double overlap_time ;
+        MPI_Allreduce(&time_passes, &overlap_time, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD) ;
+        overlap_time /= double(test_runs) ;
+
+        for(int p=0;p<numprocs;++p) {
+            int expected = personalized ? p*numprocs + myid : p ;
+            if(recv_buffer[p*msize] != expected) {
+                cerr << "recv failed on processor " << myid << " recv_buffer["
+                << p << "] = "
+                << recv_buffer[p*msize] << " should  be " << expected << endl ;
             }
         }
 
-        // Copy the final values to the recv_buffer 
-        for (i=0; i<size*numprocs; ++i) {
-            recv_buffer[i] = send_buffer[i] ; 
+        if(0 == myid) {
+            double hidden = (exchange_time + compute_time - overlap_time)/exchange_time ;
+            cout << "overlap (" << name << "), m=" << msize
+            << " exchange " << exchange_time << " compute " << compute_time
+            << " overlapped " << overlap_time << " seconds, compute/exchange "
+            << compute_time/exchange_time << ", "
+            << int(100*std::max(0.0, std::min(1.0, hidden))) << "% hidden." << endl ;
         }
     }
 }
@@ -390,7 +489,6 @@ int main(int argc, char **argv) {
 
     chopsigs_() ;
   
-    double time_passes, max_time ;
     /* Initialize MPI */
     MPI_Init(&argc,&argv) ;
 
@@ -398,14 +496,89 @@ int main(int argc, char **argv) {
     MPI_Comm_size(MPI_COMM_WORLD,&numprocs) ;
     MPI_Comm_rank(MPI_COMM_WORLD,&myid) ;
 
-    // Set the number of test runs 
-    int test_runs = 8000/numprocs ;
-    if(argc == 2) {
-        test_runs = atoi(argv[1]) ;
+    // Set the benchmark sizes, warmup and number of test runs, and
+    // the tuning table to measure (--tune) or to read (--table)
+    benchmark_options options ;
+    options.first_l = 0 ;
+    options.last_l = 16 ;
+    options.step_l = 4 ;
+    options.warmup = 10 ;
+    options.test_runs = 8000/numprocs ;
+    const char *tune_file = 0 ;
+    const char *table_file = 0 ;
+    const char *csv_file = 0 ;
+    bool profile = false ;
+    bool usage = false ;
+    for (int a=1; a<argc; ++a) {
+        if (strcmp(argv[a], "--tune") == 0 && a+1 < argc) {
+            tune_file = argv[++a] ;
+        }
+        else if (strcmp(argv[a], "--table") == 0 && a+1 < argc) {
+            table_file = argv[++a] ;
+        }
+        else if (strcmp(argv[a], "--sizes") == 0 && a+1 < argc) {
+            if (sscanf(argv[++a], "%d:%d:%d", &options.first_l, &options.last_l, &options.step_l) != 3 ||
+                options.first_l < 0 || options.last_l > 20 || options.first_l > options.last_l ||
+                options.step_l < 1) {
+                usage = true ;
+            }
+        }
+        else if (strcmp(argv[a], "--warmup") == 0 && a+1 < argc) {
+            options.warmup = atoi(argv[++a]) ;
+        }
+        else if (strcmp(argv[a], "--csv") == 0 && a+1 < argc) {
+            csv_file = argv[++a] ;
+        }
+        else if (strcmp(argv[a], "--profile") == 0) {
+            profile = true ;
+        }
+        else if (strcmp(argv[a], "--segment") == 0 && a+1 < argc) {
+            int bytes = atoi(argv[++a]) ;
+            if (bytes < 1)
+                usage = true ;
+            else
+                pipeline_segment = bytes ;
+        }
+        else if (argv[a][0] != '-') {
+            options.test_runs = atoi(argv[a]) ;
+        }
+        else {
+            usage = true ;
+        }
+    }
+    if (usage || options.test_runs < 1 || options.warmup < 0) {
+        if (myid == 0) {
+            cerr << "usage: " << argv[0] << " [--tune file | --table file] [--sizes first:last:step]"
+            << " [--warmup n] [--csv file] [--segment bytes] [--profile] [test_runs]" << endl
+            << "  messages of 2^l ints for l = first, first+step, ... last (at most 20)" << endl
+            << "  segments of the pipelined ring of the given bytes (default " << pipeline_segment << ")" << endl ;
+        }
+        MPI_Finalize() ;
+        return -1 ;
+    }
+    if (csv_file != 0) {
+        // Only processor 0 writes, but every processor must stop
+        int opened = 1 ;
+        if (myid == 0) {
+            options.csv.open(csv_file) ;
+            opened = options.csv.is_open() ;
+        }
+        MPI_Bcast(&opened, 1, MPI_INT, 0, MPI_COMM_WORLD) ;
+        if (!opened) {
+            if (myid == 0) {
+                cerr << "unable to write " << csv_file << endl ;
+            }
+            MPI_Finalize() ;
+            return -1 ;
+        }
+        if (myid == 0) {
+            options.csv.precision(10) ;
+            options.csv << "collective,algorithm,procs,ints,bytes,runs,min,median,p99,mean,MBps" << endl ;
+        }
     }
 
-    // Upper bound on message size 
-    const int max_size = pow2(16) ;
+    // Upper bound on message size, of the benchmarks and of the tuning
+    const int max_size = pow2(std::max(options.last_l, 16)) ;
 
     // Allocate a buffer size large enough to 
     // store the maximum size of a single message 
@@ -416,138 +589,92 @@ int main(int argc, char **argv) {
     if (myid == 0) {
         cout << "Starting " << numprocs << " processors." << endl ;
     }
-    
+
     /***************************************************************************/
-    /* Check Timing for Single Node Broadcast emulating an alltoall broadcast  */
+    /* Select the algorithms by message size                                   */
     /***************************************************************************/
-    
-    // Do not proceed until all processors 
-    // are ready 
-    MPI_Barrier(MPI_COMM_WORLD) ;
-
-    // We can't accurately measure short times so we must execute this
-    // operation many times to get accurate measurements 
-    for(int l=0;l<=16;l+=4) {
-
-        // Increase the message size by a factor of 4
-        // for each iteration 
-        int msize = pow2(l) ;
-
-        // Start the timer 
-        // Reset on each iteration 
-        get_timer() ;
-
-        // Loop until the test runs are completed
-        for(int i=0;i<test_runs;++i) {
-
-            // Slow All-to-All broadcast using p single node broadcasts
-            for(int p=0;p<numprocs;++p) {
-                recv_buffer[p] = 0 ;
-            }
 
-            // Create a unique message (int)
-            int send_info = myid + i*numprocs ;
+    if (tune_file != 0) {
+        tuning.Clear(numprocs) ;
+        if (myid == 0) {
+            cout << "tuning all to all broadcast" << endl ;
+        }
+        tuneCollective(tuning_table::ALLTOALL, alltoall_variants, alltoall_count,
+                       1, send_buffer, recv_buffer) ;
+        if (myid == 0) {
+            cout << "tuning all-to-all-personalized broadcast" << endl ;
+        }
+        tuneCollective(tuning_table::PERSONALIZED, personalized_variants, personalized_count,
+                       numprocs, send_buffer, recv_buffer) ;
+        if (myid == 0 && !tuning.Save(tune_file, numprocs)) {
+            cerr << "unable to write tuning table " << tune_file << endl ;
+        }
+    }
+    else if (table_file != 0 && !tuning.Load(table_file, numprocs) && myid == 0) {
+        cerr << "unable to read tuning table " << table_file << ", using the defaults" << endl ;
+    }
+    
+    /***************************************************************************/
+    /* Check Timing for All to All Broadcast Algorithms                        */
+    /***************************************************************************/
 
-            // Populate the send buffer 
-            // with the unique message 
-            for(int k=0;k<msize;++k) {
-                send_buffer[k] = send_info ;
-            }
+    benchmarkAllToAll("MPI_Allgather", LibraryAllgather, options, send_buffer, recv_buffer) ;
+    for (int v=0; v<alltoall_count; ++v) {
+        benchmarkAllToAll(alltoall_variants[v].name, alltoall_variants[v].algorithm,
+                          options, send_buffer, recv_buffer) ;
+    }
+    benchmarkAllToAll("tuned", AllToAll, options, send_buffer, recv_buffer) ;
 
-            // Perform the All-to-All broadcast algorithm 
-            AllToAll(send_buffer,recv_buffer,msize,MPI_COMM_WORLD) ;
+    /***************************************************************************/
+    /* Check Timing for All to All personalized Broadcast Algorithms           */
+    /***************************************************************************/
 
-            // Verify that the received message matches 
-            // what is to be expected 
-            for(int p=0;p<numprocs;++p) {
-	            if(recv_buffer[p*msize] != (p + i*numprocs)) {
-                    cerr << "recv failed on processor " << myid << " recv_buffer["
-                    << p << "] = "
-                    << recv_buffer[p*msize] << " should  be " << p + i*numprocs << endl ;
-                }
-            }
+    // The mesh algorithm needs a power of 2 processors,
+    // Bruck and pairwise exchange work for any number
+    benchmarkPersonalized("MPI_Alltoall", LibraryAlltoall, options, send_buffer, recv_buffer) ;
+    for (int v=0; v<personalized_count; ++v) {
+        if (personalized_variants[v].any_procs || powerOf2(numprocs)) {
+            benchmarkPersonalized(personalized_variants[v].name, personalized_variants[v].algorithm,
+                                  options, send_buffer, recv_buffer) ;
         }
-        
-        // Get the amount of time that passes
-        time_passes = get_timer() ;
-  
-        // Find the maximum time from all of the processors. 
-        // This will give us an approximation for how long each
-        // the all to all broadcast took for a particular message size
-        MPI_Reduce(&time_passes, &max_time, 1, MPI_DOUBLE,MPI_MAX, 0, MPI_COMM_WORLD) ;
-        if(myid == 0) {
-            cout << "all to all broadcast for m="<< msize << " required " << max_time/double(test_runs)
-            << " seconds." << endl ;
+        else if (myid == 0) {
+            cout << "skipping the " << personalized_variants[v].name
+            << " All-to-All Personalized with non-power of 2 processors." << endl ; 
         }
     }
+    benchmarkPersonalized("tuned", AllToAllPersonalized, options, send_buffer, recv_buffer) ;
 
-    // Make sure we don't perform All-to-All personalized 
-    // on non powers of 2
-    if ((numprocs & (numprocs - 1)) != 0) {
-        if (myid == 0) {
-            cout << endl << "WARNING: Cannot perform All-to-All Personalized with non-power of 2 processors." << endl ; 
-        }
-        MPI_Finalize() ; 
-        return 0; 
-    }
-    
     /***************************************************************************/
-    /* Check Timing for All to All personalized Broadcast Algorithm            */
+    /* Check Timing for variable count All to All personalized Broadcasts      */
     /***************************************************************************/
 
-    // Barrier to ensure that we finish all of the following 
-    // above, and that all the nodes are ready to proceed before
-    // executing the All to All personlized algorithm. 
-    MPI_Barrier(MPI_COMM_WORLD) ;
+    benchmarkPersonalizedv("MPI_Alltoallv", LibraryAlltoallv, options, send_buffer, recv_buffer) ;
+    if (powerOf2(numprocs)) {
+        benchmarkPersonalizedv("hypercube", AllToAllPersonalizedvHypercube, options, send_buffer, recv_buffer) ;
+    }
+    benchmarkPersonalizedv("pairwise", AllToAllPersonalizedvPairwise, options, send_buffer, recv_buffer) ;
+    benchmarkPersonalizedv("selected", AllToAllPersonalizedv, options, send_buffer, recv_buffer) ;
 
-    for(int l=0;l<=16;l+=4) {
-        int msize = pow2(l) ;
-        /* Every call to get_timer resets the stopwatch.  The next call to 
-        get_timer will return the amount of time since now */
-        get_timer() ;
+    /***************************************************************************/
+    /* Check how much of the non-blocking collectives computation hides        */
+    /***************************************************************************/
 
-        for(int i=0;i<test_runs;++i) {
-            for(int p=0;p<numprocs;++p) {
-	            for(int k=0;k<msize;++k) {
-                    recv_buffer[p*msize+k] = 0 ;
-                }
-            }
-      
-            int factor = (myid&1==1)?-1:1 ;
-            for(int p=0;p<numprocs;++p) {
-	            for(int k=0;k<msize;++k) {
-                    send_buffer[p*msize+k]=myid*numprocs + p + i*myid*myid*factor;
-                }
-            }
-            int send_info = myid + i*numprocs ;
+    benchmarkOverlap("all to all broadcast", IAllToAll, false, options, send_buffer, recv_buffer) ;
+    benchmarkOverlap("all-to-all-personalized broadcast", IAllToAllPersonalized, true,
+                     options, send_buffer, recv_buffer) ;
 
-            AllToAllPersonalized(send_buffer,recv_buffer,msize,MPI_COMM_WORLD) ;
-    
-            for(int p=0;p<numprocs;++p) {
-                int factor = (p&1==1)?-1:1 ;
-                if(recv_buffer[p*msize] != ( p*numprocs + myid + i*p*p*factor )) {
-                    cerr << "recv failed on processor " << myid << " recv_buffer["
-                    << p << "] = "
-                    << recv_buffer[p*msize] << " should  be " << p*numprocs + myid + i*p*p*factor << endl ;
-                }
-            }
-        }
-  
-        time_passes = get_timer() ;
-  
-        MPI_Reduce(&time_passes, &max_time, 1, MPI_DOUBLE,MPI_MAX, 0, MPI_COMM_WORLD) ;
-        
-        if(0 == myid) {
-            cout << "all-to-all-personalized broadcast, m=" << msize 
-            << " required " << max_time/double(test_runs)
-            << " seconds." << endl ;
-        }
+    // Where the time went in the collectives, over every processor
+    if (profile) {
+        profileReport(MPI_COMM_WORLD, cout) ;
     }
 
     delete[] recv_buffer ; 
     delete[] send_buffer ;
 
   
+    // Free the scratch space and node communicators of the collectives
+    collective_context::Release(MPI_COMM_WORLD) ;
+
     /* We're finished, so call MPI_Finalize() to clean things up */
     MPI_Finalize() ;
     return 0 ;
@@ -0,0 +1,53 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <mpi.h>
+#include <ostream>
+
+/******************************************************************************
+* Named, nested timing scopes.  PROFILE_SCOPE("name") times the rest of the  *
+* enclosing block, and a scope entered inside another one is recorded as its *
+* child, so the same name under different parents is counted separately.     *
+* Each scope keeps its number of calls, its total time and a histogram of    *
+* the time of each call in powers of 2 microseconds.                         *
+*                                                                            *
+* Every thread records into a tree of its own, so scopes need no locking.    *
+* profileReport merges the trees of the threads and of every processor of    *
+* comm, and processor 0 prints the calls and the min, mean and max time of   *
+* each scope over the processors that entered it.  It is collective over     *
+* comm and must run while no other thread is inside a scope.                 *
+*                                                                            *
+* Compiling with -DNO_PROFILE removes the scopes and the report.             *
+******************************************************************************/
+
+#ifdef NO_PROFILE
+
+#define PROFILE_SCOPE(name)
+
+inline void profileReport(MPI_Comm comm, std::ostream &out) {}
+
+#else
+
+class profile_scope {
+public:
+    // Start timing the scope called name, a string that outlives the run
+    explicit profile_scope(const char *name) ;
+    ~profile_scope() ;
+
+private:
+    profile_scope(const profile_scope &) ;
+    struct profile_thread *thread ;
+    int node, parent ;
+    double start ;
+} ;
+
+#define PROFILE_JOIN(a, b) a##b
+#define PROFILE_VARIABLE(line) PROFILE_JOIN(profile_scope_, line)
+#define PROFILE_SCOPE(name) profile_scope PROFILE_VARIABLE(__LINE__)(name)
+
+// Print the scopes of every processor of comm on processor 0
+void profileReport(MPI_Comm comm, std::ostream &out) ;
+
+#endif
+
+#endif
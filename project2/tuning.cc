@@ -0,0 +1,94 @@
+#include "tuning.h"
+
+#include <fstream>
+#include <sstream>
+
+using std::string ;
+using std::vector ;
+using std::ifstream ;
+using std::ofstream ;
+using std::istringstream ;
+using std::endl ;
+
+// Names of the collectives in the table file
+static const char *collective_names[tuning_table::COLLECTIVES] = {"alltoall", "personalized"} ;
+
+static int findCollective(const string &name) {
+    for (int c=0; c<tuning_table::COLLECTIVES; ++c)
+        if (name == collective_names[c])
+            return c ;
+    return -1 ;
+}
+
+void tuning_table::Clear(int procs) {
+    this->procs = procs ;
+    for (int c=0; c<COLLECTIVES; ++c)
+        entries[c].clear() ;
+}
+
+bool tuning_table::Load(const char *filename, int procs) {
+    ifstream in(filename) ;
+    if (!in)
+        return false ;
+    Clear(procs) ;
+    string line ;
+    while (getline(in, line)) {
+        istringstream fields(line) ;
+        string name, algorithm ;
+        int p ;
+        size_t max_bytes ;
+        if (!(fields >> name >> p >> max_bytes >> algorithm) || p != procs)
+            continue ;
+        int c = findCollective(name) ;
+        if (c >= 0)
+            Add(collective(c), max_bytes, algorithm.c_str()) ;
+    }
+    return true ;
+}
+
+bool tuning_table::Save(const char *filename, int procs) const {
+    // Keep the lines for other processor counts
+    vector<string> kept ;
+    {
+        ifstream in(filename) ;
+        string line ;
+        while (getline(in, line)) {
+            istringstream fields(line) ;
+            string name ;
+            int p ;
+            if (fields >> name >> p && p != procs)
+                kept.push_back(line) ;
+        }
+    }
+    ofstream out(filename) ;
+    for (size_t k=0; k<kept.size(); ++k)
+        out << kept[k] << endl ;
+    for (int c=0; c<COLLECTIVES; ++c)
+        for (size_t k=0; k<entries[c].size(); ++k)
+            out << collective_names[c] << " " << procs << " " << entries[c][k].max_bytes
+                << " " << entries[c][k].algorithm << endl ;
+    return bool(out) ;
+}
+
+void tuning_table::Add(collective c, size_t max_bytes, const char *algorithm) {
+    // Neighbouring sizes with the same algorithm share one entry
+    vector<entry> &list = entries[c] ;
+    if (!list.empty() && list.back().algorithm == algorithm) {
+        list.back().max_bytes = max_bytes ;
+        return ;
+    }
+    entry e ;
+    e.max_bytes = max_bytes ;
+    e.algorithm = algorithm ;
+    list.push_back(e) ;
+}
+
+const char *tuning_table::Select(collective c, size_t bytes) const {
+    const vector<entry> &list = entries[c] ;
+    if (list.empty())
+        return 0 ;
+    for (size_t k=0; k<list.size(); ++k)
+        if (bytes <= list[k].max_bytes)
+            return list[k].algorithm.c_str() ;
+    return list.back().algorithm.c_str() ;
+}
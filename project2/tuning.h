@@ -0,0 +1,49 @@
+#ifndef TUNING_H
+#define TUNING_H
+
+#include <vector>
+#include <string>
+#include <stddef.h>
+
+/******************************************************************************
+* The algorithm each collective uses, by message size, for the number of     *
+* processors of the run.  The table is measured once by running project2     *
+* with --tune and read back with --table.  Each line of the file is          *
+*                                                                            *
+*     collective procs max_bytes algorithm                                   *
+*                                                                            *
+* meaning the algorithm is used for blocks of up to max_bytes bytes on       *
+* procs processors.  A file holds the entries of many processor counts.      *
+******************************************************************************/
+class tuning_table {
+public:
+    enum collective {ALLTOALL, PERSONALIZED, COLLECTIVES} ;
+
+    tuning_table() : procs(0) {}
+
+    // Remove every entry and hold the entries for procs processors
+    void Clear(int procs) ;
+    // The number of processors the entries are for, 0 if there are none
+    int processors() const { return procs ; }
+    // Read the entries for procs processors from filename
+    bool Load(const char *filename, int procs) ;
+    // Write the entries for procs processors to filename, keeping the
+    // entries it already has for other processor counts
+    bool Save(const char *filename, int procs) const ;
+    // Use algorithm for blocks of up to max_bytes bytes, entries are
+    // added in increasing max_bytes
+    void Add(collective c, size_t max_bytes, const char *algorithm) ;
+    // The algorithm for blocks of bytes bytes, 0 if there is no entry.
+    // Blocks larger than every entry use the last one.
+    const char *Select(collective c, size_t bytes) const ;
+
+private:
+    struct entry {
+        size_t max_bytes ;
+        std::string algorithm ;
+    } ;
+    int procs ;
+    std::vector<entry> entries[COLLECTIVES] ;
+} ;
+
+#endif
@@ -2,6 +2,5 @@
 #define UTILITIES_H
 
 extern void chopsigs_() ;
-extern double get_timer() ;
 
 #endif